@@ -0,0 +1,135 @@
+"""Deflate vs zstd on a real file tree, as the launcher sees it at first launch.
+
+Compresses every file of a tree (by default the standard library of the running
+Python, a stand-in for the python/ layer of a bundle) the way the packager writes
+zip entries, then measures the compressed size and the single-threaded
+decompression throughput the launcher gets out of each method.
+
+Requires the zstandard package (or Python 3.14+).
+
+    python bench/bench_compression.py --tree /path/to/python --zstd-level 3 --zstd-level 9
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import statistics
+import sys
+import sysconfig
+import time
+import zlib
+from pathlib import Path
+
+REPO_DIR = Path(__file__).resolve().parent.parent
+sys.path.insert(0, str(REPO_DIR / "src"))
+
+from pyfuze.utils import zstd_compressobj  # noqa: E402
+
+
+def deflate(data: bytes, level: int) -> bytes:
+    # raw deflate without a zlib header, as zip stores it
+    compressor = zlib.compressobj(level, zlib.DEFLATED, -15)
+    return compressor.compress(data) + compressor.flush()
+
+
+def inflate(data: bytes) -> bytes:
+    return zlib.decompressobj(-15).decompress(data)
+
+
+def zstd(data: bytes, level: int) -> bytes:
+    compressor = zstd_compressobj(level)
+    return compressor.compress(data) + compressor.flush()
+
+
+try:
+    import zstandard
+
+    # one decompression context reused for every file, like the launcher's per-thread one
+    _dctx = zstandard.ZstdDecompressor()
+
+    def unzstd(data: bytes) -> bytes:
+        return _dctx.decompressobj().decompress(data)
+
+except ImportError:
+    from compression import zstd as _zstd
+
+    def unzstd(data: bytes) -> bytes:
+        return _zstd.ZstdDecompressor().decompress(data)
+
+
+def load_tree(tree: Path, max_bytes: int) -> list[bytes]:
+    files = []
+    total = 0
+    for path in sorted(tree.rglob("*")):
+        if not path.is_file() or path.is_symlink():
+            continue
+        data = path.read_bytes()
+        files.append(data)
+        total += len(data)
+        if total >= max_bytes:
+            break
+    return files
+
+
+def measure(files: list[bytes], compress, decompress, runs: int) -> dict:
+    start = time.perf_counter()
+    compressed = [compress(data) for data in files]
+    compress_seconds = time.perf_counter() - start
+
+    size = sum(len(data) for data in files)
+    timings = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        for data in compressed:
+            decompress(data)
+        timings.append(time.perf_counter() - start)
+    for data, packed in zip(files, compressed):
+        assert decompress(packed) == data
+
+    decompress_seconds = statistics.median(timings)
+    return {
+        "compressed_bytes": sum(len(data) for data in compressed),
+        "ratio": round(size / max(1, sum(len(data) for data in compressed)), 3),
+        "compress_mb_s": round(size / compress_seconds / 1e6, 1),
+        "decompress_mb_s": round(size / decompress_seconds / 1e6, 1),
+        "decompress_ms": round(decompress_seconds * 1000, 3),
+    }
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tree", type=Path, default=Path(sysconfig.get_paths()["stdlib"]), help="directory to compress (default: the standard library of this Python)")
+    parser.add_argument("--max-mb", type=int, default=512, help="stop reading the tree after this many megabytes")
+    parser.add_argument("--deflate-level", type=int, action="append", help="deflate level to measure (repeatable, default: 6)")
+    parser.add_argument("--zstd-level", type=int, action="append", help="zstd level to measure (repeatable, default: 3, 9 and 19)")
+    parser.add_argument("--runs", type=int, default=5, help="decompression passes, the median is reported")
+    parser.add_argument("--output", help="write JSON results here instead of stdout")
+    args = parser.parse_args()
+
+    files = load_tree(args.tree, args.max_mb * 1024 * 1024)
+    results = {}
+    for level in args.deflate_level or [6]:
+        results[f"deflate-{level}"] = measure(files, lambda data: deflate(data, level), inflate, args.runs)
+    for level in args.zstd_level or [3, 9, 19]:
+        results[f"zstd-{level}"] = measure(files, lambda data: zstd(data, level), unzstd, args.runs)
+
+    report = {
+        "config": {
+            "tree": str(args.tree),
+            "files": len(files),
+            "bytes": sum(len(data) for data in files),
+            "runs": args.runs,
+        },
+        "methods": results,
+    }
+    text = json.dumps(report, indent=2)
+    if args.output:
+        Path(args.output).write_text(text + "\n")
+    else:
+        print(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,228 @@
+"""End-to-end cold/warm startup benchmarks for the pyfuze launcher.
+
+Builds bundle-mode executables from a synthetic project and measures the build
+with and without the build cache, cold first launch, warm launch, post-upgrade
+launch and concurrent cold launches.
+Runs fully offline: uv, Python and the package index are replaced by the
+stand-ins in bench/offline.
+
+Requires src/pyfuze/pyfuze.com (bash compile_csrc.sh) and click.
+
+    python bench/bench_launcher.py --src-files 200 --dep-files 2000 --output bench.json
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+REPO_DIR = Path(__file__).resolve().parent.parent
+OFFLINE_DIR = Path(__file__).resolve().parent / "offline"
+
+
+def percentile(values: list[float], pct: float) -> float:
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, round(pct / 100 * (len(ordered) - 1))))
+    return ordered[index]
+
+
+def make_project(root: Path, src_files: int, variant: str) -> Path:
+    project = root / "benchapp"
+    pkg = project / "pkg"
+    pkg.mkdir(parents=True, exist_ok=True)
+    (pkg / "__init__.py").write_text("")
+    for i in range(src_files):
+        (pkg / f"mod_{i}.py").write_text(
+            f"VALUE = {i}\n\n\ndef f(x):\n    return x + VALUE\n"
+        )
+    imports = "\n".join(f"import pkg.mod_{i}" for i in range(src_files))
+    (project / "main.py").write_text(
+        f"{imports}\nVARIANT = {variant!r}\nraise SystemExit(0)\n"
+    )
+    return project
+
+
+# Synthetic dependency tree served by the fake uv as its package index.
+# A stored_ratio share of the files is random (incompressible), the rest is text.
+def make_index(root: Path, dep_files: int, dep_size: int, stored_ratio: float) -> Path:
+    index = root / "index"
+    rng = random.Random(0)
+    text = (b"def function_%d(x):\n    return x\n" * (dep_size // 24 + 1))[:dep_size]
+    for i in range(dep_files):
+        path = index / f"pkg_{i % 50}" / f"file_{i}.py"
+        path.parent.mkdir(parents=True, exist_ok=True)
+        if rng.random() < stored_ratio:
+            path.with_suffix(".so").write_bytes(os.urandom(dep_size))
+        else:
+            path.write_bytes(text)
+    return index
+
+
+def build(workdir: Path, project: Path, unzip_path: Path, name: str, extra_args: list[str], env: dict) -> Path:
+    cmd = [
+        sys.executable,
+        "-m",
+        "pyfuze",
+        str(project),
+        "--entry",
+        "main.py",
+        "--unzip-path",
+        str(unzip_path),
+        "--output-name",
+        name,
+        "--uv-install-script-unix",
+        str(OFFLINE_DIR / "install.sh"),
+        *extra_args,
+    ]
+    subprocess.run(cmd, cwd=workdir, env=env, check=True, stdout=subprocess.DEVNULL)
+    return workdir / "dist" / name
+
+
+def launch(exe: Path, env: dict) -> dict:
+    start = time.perf_counter()
+    proc = subprocess.run([str(exe)], env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, stdin=subprocess.DEVNULL)
+    wall_ms = (time.perf_counter() - start) * 1000
+    if proc.returncode != 0:
+        raise RuntimeError(f"{exe} exited with {proc.returncode}")
+    return {"wall_ms": wall_ms}
+
+
+# One extra launch with PYFUZE_TRACE for the extraction counters and, when
+# strace is installed, a syscall count of the whole process tree.
+def instrumented_launch(exe: Path, env: dict, scratch: Path) -> dict:
+    trace_path = scratch / "trace.json"
+    strace_path = scratch / "strace.txt"
+    env = dict(env, PYFUZE_TRACE=str(trace_path))
+    cmd = [str(exe)]
+    if shutil.which("strace"):
+        cmd = ["strace", "-f", "-c", "-o", str(strace_path), *cmd]
+    subprocess.run(cmd, env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, stdin=subprocess.DEVNULL)
+
+    result: dict = {}
+    if trace_path.exists():
+        for event in json.loads(trace_path.read_text())["traceEvents"]:
+            if event["name"] == "extracted":
+                result["files_extracted"] = event["args"]["files"]
+                result["bytes_extracted"] = event["args"]["bytes"]
+            elif event.get("cat") == "phase":
+                result.setdefault("phases_ms", {})[event["name"]] = event["dur"] / 1000
+    if strace_path.exists():
+        for line in strace_path.read_text().splitlines():
+            parts = line.split()
+            if parts and parts[-1] == "total":
+                result["syscalls"] = int(parts[3])
+    return result
+
+
+def summarize(samples: list[dict]) -> dict:
+    walls = [s["wall_ms"] for s in samples]
+    return {
+        "runs": len(walls),
+        "p50_ms": round(percentile(walls, 50), 3),
+        "p99_ms": round(percentile(walls, 99), 3),
+        "mean_ms": round(statistics.mean(walls), 3),
+        "min_ms": round(min(walls), 3),
+        "max_ms": round(max(walls), 3),
+    }
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--src-files", type=int, default=50, help="number of application modules")
+    parser.add_argument("--dep-files", type=int, default=500, help="number of dependency files")
+    parser.add_argument("--dep-size", type=int, default=16384, help="size of each dependency file in bytes")
+    parser.add_argument("--stored-ratio", type=float, default=0.2, help="share of incompressible dependency files")
+    parser.add_argument("--runs", type=int, default=10, help="launches per scenario")
+    parser.add_argument("--concurrency", type=int, default=8, help="simultaneous cold launches")
+    parser.add_argument("--download-delay", type=float, default=0, help="seconds the fake uv installer and Python download take at runtime (online mode)")
+    parser.add_argument("--pyfuze-arg", action="append", default=[], help="extra packager argument (repeatable)")
+    parser.add_argument("--output", help="write JSON results here instead of stdout")
+    parser.add_argument("--keep", action="store_true", help="keep the work directory")
+    args = parser.parse_args()
+
+    if not (REPO_DIR / "src" / "pyfuze" / "pyfuze.com").exists():
+        print("src/pyfuze/pyfuze.com not found, run `bash compile_csrc.sh` first", file=sys.stderr)
+        return 1
+
+    workdir = Path(tempfile.mkdtemp(prefix="pyfuze-bench-"))
+    unzip_path = workdir / "unzip"
+    env = dict(os.environ)
+    env["PYTHONPATH"] = str(REPO_DIR / "src") + os.pathsep + env.get("PYTHONPATH", "")
+    env["PYFUZE_BENCH_PYTHON"] = sys.executable
+    env["PYFUZE_BENCH_INDEX"] = str(make_index(workdir, args.dep_files, args.dep_size, args.stored_ratio))
+    run_env = {k: v for k, v in os.environ.items() if not k.startswith("PYFUZE_")}
+    run_env["PYFUZE_BENCH_DOWNLOAD_DELAY"] = str(args.download_delay)
+
+    try:
+        # the second build only differs in src/ and reuses the build cache of the first
+        start = time.perf_counter()
+        exe_a = build(workdir, make_project(workdir / "a", args.src_files, "a"), unzip_path, "bench_a.com", args.pyfuze_arg, env)
+        build_ms = (time.perf_counter() - start) * 1000
+        start = time.perf_counter()
+        exe_b = build(workdir, make_project(workdir / "b", args.src_files, "b"), unzip_path, "bench_b.com", args.pyfuze_arg, env)
+        cached_build_ms = (time.perf_counter() - start) * 1000
+
+        results: dict = {}
+        results["build"] = {"first_ms": round(build_ms, 3), "cached_ms": round(cached_build_ms, 3)}
+
+        cold = []
+        for _ in range(args.runs):
+            shutil.rmtree(unzip_path, ignore_errors=True)
+            cold.append(launch(exe_a, run_env))
+        results["cold"] = summarize(cold)
+        shutil.rmtree(unzip_path, ignore_errors=True)
+        results["cold"].update(instrumented_launch(exe_a, run_env, workdir))
+
+        warm = [launch(exe_a, run_env) for _ in range(args.runs)]
+        results["warm"] = summarize(warm)
+        results["warm"].update(instrumented_launch(exe_a, run_env, workdir))
+
+        # every launch switches build id, costing one delta extraction
+        upgrade = [launch(exe_b if i % 2 == 0 else exe_a, run_env) for i in range(args.runs)]
+        results["upgrade"] = summarize(upgrade)
+        results["upgrade"].update(instrumented_launch(exe_b if args.runs % 2 == 0 else exe_a, run_env, workdir))
+
+        shutil.rmtree(unzip_path, ignore_errors=True)
+        start = time.perf_counter()
+        with ThreadPoolExecutor(args.concurrency) as pool:
+            concurrent = list(pool.map(lambda _: launch(exe_a, run_env), range(args.concurrency)))
+        results["concurrent_cold"] = summarize(concurrent)
+        results["concurrent_cold"]["total_ms"] = round((time.perf_counter() - start) * 1000, 3)
+
+        report = {
+            "config": {
+                "src_files": args.src_files,
+                "dep_files": args.dep_files,
+                "dep_size": args.dep_size,
+                "stored_ratio": args.stored_ratio,
+                "runs": args.runs,
+                "concurrency": args.concurrency,
+                "download_delay": args.download_delay,
+                "pyfuze_args": args.pyfuze_arg,
+                "bundle_bytes": exe_a.stat().st_size,
+            },
+            "scenarios": results,
+        }
+        text = json.dumps(report, indent=2)
+        if args.output:
+            Path(args.output).write_text(text + "\n")
+        else:
+            print(text)
+        return 0
+    finally:
+        if not args.keep:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
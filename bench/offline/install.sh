@@ -0,0 +1,15 @@
+#!/bin/sh
+# Offline stand-in for https://astral.sh/uv/install.sh used by the benchmarks.
+# Installs the fake uv next to this script into $UV_UNMANAGED_INSTALL.
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+dest=${UV_UNMANAGED_INSTALL:-uv}
+host_python=${PYFUZE_BENCH_PYTHON:-$(command -v python3)}
+
+# simulated download time, to measure how much of it startup overlaps
+sleep "${PYFUZE_BENCH_DOWNLOAD_DELAY:-0}"
+
+mkdir -p "$dest"
+sed "s|@HOST_PYTHON@|$host_python|" "$here/uv" > "$dest/uv"
+chmod 755 "$dest/uv"
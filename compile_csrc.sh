@@ -1 +1 @@
-cosmocc -mcosmo csrc/*.c -o src/pyfuze/pyfuze.com && find src/pyfuze -maxdepth 1 -type f -name 'pyfuze*' ! -name 'pyfuze.com' -delete
+cosmocc -mcosmo -DZSTD_DISABLE_ASM -DZSTD_TRACE=0 csrc/*.c csrc/third_party/zstd/common/*.c csrc/third_party/zstd/decompress/*.c -o src/pyfuze/pyfuze.com && find src/pyfuze -maxdepth 1 -type f -name 'pyfuze*' ! -name 'pyfuze.com' -delete
@@ -3,9 +3,29 @@
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include "sys/mman.h"
 
 #define INITIAL_CAPACITY 16
 
+// Binary launch manifest written by the packager, all integers little-endian:
+//   header   "PYFZCFG1", version, item_count, bucket_count, file_count, strings_offset, strings_size
+//   buckets  bucket_count x u32, 1-based item index by FNV-1a of the key with linear probing, 0 = empty
+//   items    item_count x {hash, key_offset, key_length, value_offset, value_length}
+//   files    file_count x {u64 size, crc32, mode, path_offset, path_length, hash_offset, source}
+//            source is the 1-based index of the file whose archive entry holds this
+//            file's content, 0 if it has an entry of its own
+//   strings  NUL-terminated strings, offsets are relative to strings_offset
+#define BINARY_MAGIC "PYFZCFG1"
+#define BINARY_VERSION 1
+#define HEADER_SIZE 32
+#define BUCKET_SIZE 4
+#define ITEM_SIZE 20
+#define FILE_RECORD_SIZE 32
+#define NO_STRING 0xffffffffu
+#define SHA256_HEX_LENGTH 64
+// Windows can only map files at the 64k allocation granularity
+#define MAP_ALIGNMENT 65536
+
 // Helper function to trim whitespace from both ends of a string
 static char* trim_whitespace(char* str) {
     char* end;
@@ -31,6 +51,10 @@ Config* parse_config(const char* filename) {
     }
     config->count = 0;
     config->capacity = INITIAL_CAPACITY;
+    config->map = NULL;
+    config->map_size = 0;
+    config->blob = NULL;
+    config->blob_size = 0;
     config->items = (ConfigItem*)malloc(sizeof(ConfigItem) * config->capacity);
     if (!config->items) {
         free(config);
@@ -66,9 +90,114 @@ Config* parse_config(const char* filename) {
     return config;
 }
 
+static uint32_t read_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const unsigned char* p) {
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+static uint32_t fnv1a32(const char* s, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#define ITEM_COUNT(blob) read_u32((blob) + 12)
+#define BUCKET_COUNT(blob) read_u32((blob) + 16)
+#define FILE_COUNT(blob) read_u32((blob) + 20)
+#define STRINGS_OFFSET(blob) read_u32((blob) + 24)
+#define STRINGS_SIZE(blob) read_u32((blob) + 28)
+#define BUCKETS(blob) ((blob) + HEADER_SIZE)
+#define ITEMS(blob) (BUCKETS(blob) + (size_t)BUCKET_COUNT(blob) * BUCKET_SIZE)
+#define FILES(blob) (ITEMS(blob) + (size_t)ITEM_COUNT(blob) * ITEM_SIZE)
+#define STRINGS(blob) ((const char*)(blob) + STRINGS_OFFSET(blob))
+
+// A string reference must lie inside the pool and end with its NUL terminator
+static int valid_string(const unsigned char* blob, uint32_t offset, uint32_t length) {
+    uint64_t end = (uint64_t)offset + length;
+    return end < STRINGS_SIZE(blob) && STRINGS(blob)[end] == '\0';
+}
+
+// Check every offset once up front so lookups can trust the table
+static int validate_blob(const unsigned char* blob, size_t size) {
+    if (size < HEADER_SIZE || memcmp(blob, BINARY_MAGIC, 8) != 0) return 0;
+    if (read_u32(blob + 8) != BINARY_VERSION) return 0;
+
+    uint64_t item_count = ITEM_COUNT(blob);
+    uint64_t bucket_count = BUCKET_COUNT(blob);
+    uint64_t file_count = FILE_COUNT(blob);
+    if (bucket_count == 0 || (bucket_count & (bucket_count - 1)) != 0 || item_count > bucket_count) return 0;
+    uint64_t tables_end = HEADER_SIZE + bucket_count * BUCKET_SIZE + item_count * ITEM_SIZE + file_count * FILE_RECORD_SIZE;
+    if (tables_end > STRINGS_OFFSET(blob) || (uint64_t)STRINGS_OFFSET(blob) + STRINGS_SIZE(blob) > size) return 0;
+
+    for (uint64_t i = 0; i < bucket_count; i++) {
+        if (read_u32(BUCKETS(blob) + i * BUCKET_SIZE) > item_count) return 0;
+    }
+    for (uint64_t i = 0; i < item_count; i++) {
+        const unsigned char* item = ITEMS(blob) + i * ITEM_SIZE;
+        if (!valid_string(blob, read_u32(item + 4), read_u32(item + 8))) return 0;
+        if (!valid_string(blob, read_u32(item + 12), read_u32(item + 16))) return 0;
+    }
+    for (uint64_t i = 0; i < file_count; i++) {
+        const unsigned char* file = FILES(blob) + i * FILE_RECORD_SIZE;
+        if (!valid_string(blob, read_u32(file + 16), read_u32(file + 20))) return 0;
+        uint32_t hash_offset = read_u32(file + 24);
+        if (hash_offset != NO_STRING && !valid_string(blob, hash_offset, SHA256_HEX_LENGTH)) return 0;
+        if (read_u32(file + 28) > file_count) return 0;
+    }
+    return 1;
+}
+
+// Map the binary launch manifest stored (uncompressed) at offset in fd.
+// Nothing is copied or allocated per item, lookups read the mapping directly.
+Config* map_config(int fd, int64_t offset, size_t size) {
+    int64_t map_offset = offset - offset % MAP_ALIGNMENT;
+    size_t map_size = size + (size_t)(offset - map_offset);
+    void* map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, map_offset);
+    if (map == MAP_FAILED) return NULL;
+
+    const unsigned char* blob = (const unsigned char*)map + (offset - map_offset);
+    Config* config = validate_blob(blob, size) ? (Config*)malloc(sizeof(Config)) : NULL;
+    if (!config) {
+        munmap(map, map_size);
+        return NULL;
+    }
+    config->items = NULL;
+    config->count = 0;
+    config->capacity = 0;
+    config->map = map;
+    config->map_size = map_size;
+    config->blob = blob;
+    config->blob_size = size;
+    return config;
+}
+
+static const char* binary_config_value(const Config* config, const char* key) {
+    const unsigned char* blob = config->blob;
+    size_t key_len = strlen(key);
+    uint32_t hash = fnv1a32(key, key_len);
+    uint32_t mask = BUCKET_COUNT(blob) - 1;
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        uint32_t index = read_u32(BUCKETS(blob) + (size_t)((hash + probe) & mask) * BUCKET_SIZE);
+        if (index == 0) return NULL;
+        const unsigned char* item = ITEMS(blob) + (size_t)(index - 1) * ITEM_SIZE;
+        if (read_u32(item) == hash && read_u32(item + 8) == key_len &&
+            memcmp(STRINGS(blob) + read_u32(item + 4), key, key_len) == 0) {
+            return STRINGS(blob) + read_u32(item + 12);
+        }
+    }
+    return NULL;
+}
+
 // Get the value for a given key
 const char* get_config_value(const Config* config, const char* key) {
     if (!config || !key) return NULL;
+    if (config->blob) return binary_config_value(config, key);
     for (size_t i = 0; i < config->count; ++i) {
         if (strcmp(config->items[i].key, key) == 0) {
             return config->items[i].value;
@@ -77,6 +206,41 @@ const char* get_config_value(const Config* config, const char* key) {
     return NULL;
 }
 
+// Items in the order they were written, for iterating env_ keys
+size_t config_item_count(const Config* config) {
+    if (!config) return 0;
+    return config->blob ? ITEM_COUNT(config->blob) : config->count;
+}
+
+const char* config_key_at(const Config* config, size_t index) {
+    if (config->blob) return STRINGS(config->blob) + read_u32(ITEMS(config->blob) + index * ITEM_SIZE + 4);
+    return config->items[index].key;
+}
+
+const char* config_value_at(const Config* config, size_t index) {
+    if (config->blob) return STRINGS(config->blob) + read_u32(ITEMS(config->blob) + index * ITEM_SIZE + 12);
+    return config->items[index].value;
+}
+
+// Inline file index of the binary manifest, sorted by path. Text configs have none.
+size_t config_file_count(const Config* config) {
+    return config && config->blob ? FILE_COUNT(config->blob) : 0;
+}
+
+int config_file_at(const Config* config, size_t index, const char** path, const char** hash, const char** source, uint64_t* size, uint32_t* crc32, uint32_t* mode) {
+    if (index >= config_file_count(config)) return 0;
+    const unsigned char* file = FILES(config->blob) + index * FILE_RECORD_SIZE;
+    uint32_t hash_offset = read_u32(file + 24);
+    uint32_t source_index = read_u32(file + 28);
+    *size = read_u64(file);
+    *crc32 = read_u32(file + 8);
+    *mode = read_u32(file + 12);
+    *path = STRINGS(config->blob) + read_u32(file + 16);
+    *hash = hash_offset == NO_STRING ? NULL : STRINGS(config->blob) + hash_offset;
+    *source = source_index == 0 ? NULL : STRINGS(config->blob) + read_u32(FILES(config->blob) + (size_t)(source_index - 1) * FILE_RECORD_SIZE + 16);
+    return 1;
+}
+
 // Free the Config and its resources
 void free_config(Config* config) {
     if (!config) return;
@@ -85,5 +249,6 @@ void free_config(Config* config) {
         free(config->items[i].value);
     }
     free(config->items);
+    if (config->map) munmap(config->map, config->map_size);
     free(config);
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "stddef.h"
+#include "stdint.h"
+
 typedef struct {
     char* key;
     char* value;
@@ -9,8 +12,19 @@ typedef struct {
     ConfigItem* items;
     size_t count;
     size_t capacity;
+    // binary launch manifest, mapped read-only instead of parsed into items
+    void* map;
+    size_t map_size;
+    const unsigned char* blob;
+    size_t blob_size;
 } Config;
 
 Config* parse_config(const char* filename);
+Config* map_config(int fd, int64_t offset, size_t size);
 const char* get_config_value(const Config* config, const char* key);
+size_t config_item_count(const Config* config);
+const char* config_key_at(const Config* config, size_t index);
+const char* config_value_at(const Config* config, size_t index);
+size_t config_file_count(const Config* config);
+int config_file_at(const Config* config, size_t index, const char** path, const char** hash, const char** source, uint64_t* size, uint32_t* crc32, uint32_t* mode);
 void free_config(Config* config);
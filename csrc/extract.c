@@ -0,0 +1,310 @@
+#include "extract.h"
+
+#include "dirent.h"
+#include "limits.h"
+#include "pthread.h"
+#include "stdatomic.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "store.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "unistd.h"
+#include "utils.h"
+
+#define INITIAL_CAPACITY 256
+#define MAX_EXTRACT_THREADS 64
+#define JOURNAL_BUFFER_SIZE 4096
+
+// Each worker owns a [begin, end) slice of the plan packed into one atomic word,
+// so the owner popping from the front and thieves splitting off the back can't race.
+typedef struct {
+    _Atomic uint64_t range;
+} WorkerQueue;
+
+typedef struct {
+    ExtractPlan *plan;
+    WorkerQueue *queues;
+    int num_workers;
+    int index;
+} Worker;
+
+// Completed paths are batched per worker, one O_APPEND write keeps each batch whole
+typedef struct {
+    int fd;
+    size_t size;
+    char data[JOURNAL_BUFFER_SIZE];
+} JournalBuffer;
+
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+}
+
+void init_extract_plan(ExtractPlan *plan) {
+    plan->count = 0;
+    plan->capacity = INITIAL_CAPACITY;
+    plan->journal_fd = -1;
+    plan->jobs = (ExtractJob *)malloc(sizeof(ExtractJob) * plan->capacity);
+    if (!plan->jobs) exit_with_message("Failed to allocate extract plan");
+}
+
+void plan_add_file(ExtractPlan *plan, const char *src_path, const char *dst_path) {
+    plan_add_object(plan, src_path, dst_path, NULL, 0);
+}
+
+static ExtractJob *append_job(ExtractPlan *plan) {
+    if (plan->count >= plan->capacity) {
+        size_t new_capacity = plan->capacity * 2;
+        ExtractJob *new_jobs = (ExtractJob *)realloc(plan->jobs, sizeof(ExtractJob) * new_capacity);
+        if (!new_jobs) exit_with_message("Failed to allocate extract plan");
+        plan->jobs = new_jobs;
+        plan->capacity = new_capacity;
+    }
+    return &plan->jobs[plan->count++];
+}
+
+// A file with a content hash is materialized through the shared store when it is enabled
+void plan_add_object(ExtractPlan *plan, const char *src_path, const char *dst_path, const char *hash, uint32_t mode) {
+    ExtractJob *job = append_job(plan);
+    job->src_path = strdup(src_path);
+    job->dst_path = strdup(dst_path);
+    job->hash = hash ? strdup(hash) : NULL;
+    job->mode = mode;
+    job->link = 0;
+}
+
+// Hardlink dst_path to the extracted file src_path once every copy of the plan is
+// done, so a source extracted by the same plan is complete by then
+void plan_add_link(ExtractPlan *plan, const char *src_path, const char *dst_path) {
+    ExtractJob *job = append_job(plan);
+    job->src_path = strdup(src_path);
+    job->dst_path = strdup(dst_path);
+    job->hash = NULL;
+    job->mode = 0;
+    job->link = 1;
+}
+
+// Walk src_dir once, creating the directory skeleton under dst_dir and
+// queueing every regular file for the worker pool.
+void plan_add_directory(ExtractPlan *plan, const char *src_dir, const char *dst_dir) {
+    struct stat st;
+    if (stat(src_dir, &st) != 0) exit_with_message("stat %s failed", src_dir);
+
+    if (!path_exists(dst_dir)) {
+        mkdir_recursive(dst_dir);
+    }
+
+    DIR *dir = opendir(src_dir);
+    if (!dir) exit_with_message("opendir %s failed", src_dir);
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        char src_path[PATH_MAX];
+        char dst_path[PATH_MAX];
+        snprintf(src_path, sizeof(src_path), "%s/%s", src_dir, entry->d_name);
+        snprintf(dst_path, sizeof(dst_path), "%s/%s", dst_dir, entry->d_name);
+
+        if (stat(src_path, &st) != 0) {
+            closedir(dir);
+            exit_with_message("stat %s failed", src_path);
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            plan_add_directory(plan, src_path, dst_path);
+        } else if (S_ISREG(st.st_mode)) {
+            plan_add_file(plan, src_path, dst_path);
+        }
+    }
+
+    closedir(dir);
+}
+
+static int pop_front(WorkerQueue *queue, size_t *job) {
+    uint64_t range = atomic_load(&queue->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)(range >> 32);
+        uint32_t end = (uint32_t)range;
+        if (begin >= end) return 0;
+        if (atomic_compare_exchange_weak(&queue->range, &range, pack_range(begin + 1, end))) {
+            *job = begin;
+            return 1;
+        }
+    }
+}
+
+// Split off the back half of the victim's remaining slice.
+static int steal_half(WorkerQueue *victim, uint32_t *stolen_begin, uint32_t *stolen_end) {
+    uint64_t range = atomic_load(&victim->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)(range >> 32);
+        uint32_t end = (uint32_t)range;
+        if (begin >= end) return 0;
+        uint32_t mid = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(begin, mid))) {
+            *stolen_begin = mid;
+            *stolen_end = end;
+            return 1;
+        }
+    }
+}
+
+static int steal_work(Worker *worker) {
+    uint32_t begin, end;
+    for (int i = 1; i < worker->num_workers; i++) {
+        int victim = (worker->index + i) % worker->num_workers;
+        if (steal_half(&worker->queues[victim], &begin, &end)) {
+            atomic_store(&worker->queues[worker->index].range, pack_range(begin, end));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Falls back to a (reflink capable) copy where hardlinks aren't supported, and to the
+// archive if the source went missing.
+static void run_link_job(const ExtractJob *job) {
+    if (link_file(job->src_path, job->dst_path) == 0) {
+        debug_log("linked %s to %s\n", job->dst_path, job->src_path);
+        return;
+    }
+    char zip_path[PATH_MAX];
+    path_join(zip_path, sizeof(zip_path), "/zip", job->src_path);
+    copy_file(path_exists(job->src_path) ? job->src_path : zip_path, job->dst_path);
+}
+
+static void run_job(const ExtractJob *job) {
+    if (job->link) {
+        run_link_job(job);
+    } else if (job->hash && store_enabled()) {
+        store_materialize(job->hash, job->mode, job->src_path, job->dst_path);
+    } else {
+        copy_file(job->src_path, job->dst_path);
+    }
+}
+
+static void flush_journal(JournalBuffer *journal) {
+    if (journal->size == 0) return;
+    // a lost batch only means those files are extracted again after an interruption
+    if (write(journal->fd, journal->data, journal->size) < 0) debug_log("failed to write the extraction journal\n");
+    journal->size = 0;
+}
+
+static void journal_done(JournalBuffer *journal, const char *path) {
+    if (journal->fd == -1) return;
+    size_t len = strlen(path) + 1;
+    if (journal->size + len > sizeof(journal->data)) flush_journal(journal);
+    if (len > sizeof(journal->data)) return;
+    memcpy(journal->data + journal->size, path, len - 1);
+    journal->data[journal->size + len - 1] = '\n';
+    journal->size += len;
+}
+
+static void *extract_worker(void *arg) {
+    Worker *worker = (Worker *)arg;
+    WorkerQueue *own = &worker->queues[worker->index];
+    JournalBuffer journal;
+    journal.fd = worker->plan->journal_fd;
+    journal.size = 0;
+    size_t job;
+    do {
+        while (pop_front(own, &job)) {
+            run_job(&worker->plan->jobs[job]);
+            journal_done(&journal, worker->plan->jobs[job].dst_path);
+        }
+    } while (steal_work(worker));
+    flush_journal(&journal);
+    return NULL;
+}
+
+static int resolve_thread_count(int num_threads, size_t job_count) {
+    if (num_threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (num_threads > MAX_EXTRACT_THREADS) num_threads = MAX_EXTRACT_THREADS;
+    if ((size_t)num_threads > job_count) num_threads = (int)job_count;
+    return num_threads < 1 ? 1 : num_threads;
+}
+
+// Run jobs [first, first + count) of the plan on num_threads workers
+static void run_jobs(ExtractPlan *plan, size_t first, size_t count, int num_threads) {
+    if (count == 0) return;
+    num_threads = resolve_thread_count(num_threads, count);
+    WorkerQueue queues[MAX_EXTRACT_THREADS];
+    Worker workers[MAX_EXTRACT_THREADS];
+    pthread_t threads[MAX_EXTRACT_THREADS];
+
+    // hand out contiguous slices up front, stealing rebalances the tail
+    size_t per_worker = count / num_threads;
+    size_t remainder = count % num_threads;
+    size_t begin = first;
+    for (int i = 0; i < num_threads; i++) {
+        size_t end = begin + per_worker + ((size_t)i < remainder ? 1 : 0);
+        atomic_init(&queues[i].range, pack_range((uint32_t)begin, (uint32_t)end));
+        workers[i].plan = plan;
+        workers[i].queues = queues;
+        workers[i].num_workers = num_threads;
+        workers[i].index = i;
+        begin = end;
+    }
+
+    // the calling thread works as worker 0
+    int started = 1;
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, extract_worker, &workers[i]) != 0) break;
+        started++;
+    }
+    extract_worker(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // workers that failed to start still own a slice, drain it here
+    for (int i = started; i < num_threads; i++) {
+        extract_worker(&workers[i]);
+    }
+}
+
+// Copy every queued file using num_threads workers (<= 0 means one per core), then
+// create the queued hardlinks, whose sources may be among the copies.
+// Any failure still goes through exit_with_message and terminates the launcher.
+void run_extract_plan(ExtractPlan *plan, int num_threads) {
+    if (plan->count == 0) return;
+    if (plan->count > UINT32_MAX) exit_with_message("Too many files to extract: %zu", plan->count);
+
+    // move the links behind the copies, the order within each group is kept
+    size_t copies = 0;
+    for (size_t i = 0; i < plan->count; i++) {
+        if (!plan->jobs[i].link) copies++;
+    }
+    if (copies < plan->count) {
+        ExtractJob *jobs = (ExtractJob *)malloc(sizeof(ExtractJob) * plan->capacity);
+        if (!jobs) exit_with_message("Failed to allocate extract plan");
+        size_t next_copy = 0;
+        size_t next_link = copies;
+        for (size_t i = 0; i < plan->count; i++) {
+            jobs[plan->jobs[i].link ? next_link++ : next_copy++] = plan->jobs[i];
+        }
+        free(plan->jobs);
+        plan->jobs = jobs;
+    }
+    run_jobs(plan, 0, copies, num_threads);
+    run_jobs(plan, copies, plan->count - copies, num_threads);
+}
+
+void free_extract_plan(ExtractPlan *plan) {
+    for (size_t i = 0; i < plan->count; i++) {
+        free(plan->jobs[i].src_path);
+        free(plan->jobs[i].dst_path);
+        free(plan->jobs[i].hash);
+    }
+    free(plan->jobs);
+    plan->jobs = NULL;
+    plan->count = 0;
+    plan->capacity = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+typedef struct {
+    char* src_path;
+    char* dst_path;
+    char* hash;
+    uint32_t mode;
+    // src_path is another extracted file to hardlink, done after every copy
+    int link;
+} ExtractJob;
+
+typedef struct {
+    ExtractJob* jobs;
+    size_t count;
+    size_t capacity;
+    int journal_fd;
+} ExtractPlan;
+
+void init_extract_plan(ExtractPlan* plan);
+void plan_add_file(ExtractPlan* plan, const char* src_path, const char* dst_path);
+void plan_add_object(ExtractPlan* plan, const char* src_path, const char* dst_path, const char* hash, uint32_t mode);
+void plan_add_link(ExtractPlan* plan, const char* src_path, const char* dst_path);
+void plan_add_directory(ExtractPlan* plan, const char* src_dir, const char* dst_dir);
+void run_extract_plan(ExtractPlan* plan, int num_threads);
+void free_extract_plan(ExtractPlan* plan);
@@ -0,0 +1,193 @@
+#include "fastcopy.h"
+
+#include "libc/dce.h"
+#include "libc/errno.h"
+#include "pthread.h"
+#include "stdlib.h"
+#include "sys/ioctl.h"
+#include "sys/sendfile.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+// linux/fs.h, not exposed by every libc
+#ifndef FICLONERANGE
+#define FICLONERANGE 0x4020940d
+#endif
+
+#define MAX_TRACKED_DEVICES 16
+#define COPY_CHUNK_SIZE (1024 * 1024)
+
+struct file_clone_range_args {
+    int64_t src_fd;
+    uint64_t src_offset;
+    uint64_t src_length;
+    uint64_t dest_offset;
+};
+
+// Strategies that failed with "not supported" are remembered per (source, destination)
+// filesystem pair so later files go straight to the first one that works there.
+typedef struct {
+    dev_t src_dev;
+    dev_t dst_dev;
+    unsigned disabled;
+} DevicePair;
+
+static DevicePair device_pairs[MAX_TRACKED_DEVICES];
+static size_t device_pair_count = 0;
+static pthread_mutex_t device_pairs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *copy_strategy_name(int strategy) {
+    switch (strategy) {
+        case COPY_REFLINK:
+            return "reflink";
+        case COPY_FILE_RANGE:
+            return "copy_file_range";
+        case COPY_SENDFILE:
+            return "sendfile";
+        case COPY_READ_WRITE:
+            return "read/write";
+        default:
+            return "failed";
+    }
+}
+
+static unsigned disabled_strategies(dev_t src_dev, dev_t dst_dev) {
+    unsigned disabled = 0;
+    pthread_mutex_lock(&device_pairs_lock);
+    for (size_t i = 0; i < device_pair_count; i++) {
+        if (device_pairs[i].src_dev == src_dev && device_pairs[i].dst_dev == dst_dev) {
+            disabled = device_pairs[i].disabled;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&device_pairs_lock);
+    return disabled;
+}
+
+static void disable_strategy(dev_t src_dev, dev_t dst_dev, int strategy) {
+    pthread_mutex_lock(&device_pairs_lock);
+    size_t i;
+    for (i = 0; i < device_pair_count; i++) {
+        if (device_pairs[i].src_dev == src_dev && device_pairs[i].dst_dev == dst_dev) break;
+    }
+    if (i == device_pair_count) {
+        if (device_pair_count == MAX_TRACKED_DEVICES) {
+            pthread_mutex_unlock(&device_pairs_lock);
+            return;
+        }
+        device_pairs[i].src_dev = src_dev;
+        device_pairs[i].dst_dev = dst_dev;
+        device_pairs[i].disabled = 0;
+        device_pair_count++;
+    }
+    device_pairs[i].disabled |= 1u << strategy;
+    pthread_mutex_unlock(&device_pairs_lock);
+}
+
+// errors meaning the strategy can't work on this filesystem pair at all
+static int is_unsupported(int err) {
+    return err == EXDEV || err == ENOSYS || err == EOPNOTSUPP || err == ENOTTY || err == EBADF || err == EINVAL;
+}
+
+// Share the block-aligned part of the source range with the destination (btrfs, xfs, ...).
+// Clone offsets must be block aligned, the unaligned tail is left to the next strategy.
+static int reflink_range(int src_fd, int64_t src_offset, int dst_fd, uint64_t length, blksize_t block_size, uint64_t *done) {
+    if (block_size <= 0 || src_offset % block_size != 0) return 0;
+    uint64_t aligned = length - length % (uint64_t)block_size;
+    if (aligned == 0) return 0;
+
+    struct file_clone_range_args args;
+    args.src_fd = src_fd;
+    args.src_offset = (uint64_t)src_offset;
+    args.src_length = aligned;
+    args.dest_offset = 0;
+    if (ioctl(dst_fd, FICLONERANGE, &args) != 0) return -1;
+    *done = aligned;
+    return 0;
+}
+
+static int copy_file_range_loop(int src_fd, int64_t src_offset, int dst_fd, uint64_t length, uint64_t *done) {
+    while (*done < length) {
+        int64_t in = src_offset + (int64_t)*done;
+        int64_t out = (int64_t)*done;
+        ssize_t n = copy_file_range(src_fd, &in, dst_fd, &out, length - *done, 0);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        *done += (uint64_t)n;
+    }
+    return *done == length ? 0 : -1;
+}
+
+static int sendfile_loop(int src_fd, int64_t src_offset, int dst_fd, uint64_t length, uint64_t *done) {
+    if (lseek(dst_fd, (int64_t)*done, SEEK_SET) == -1) return -1;
+    while (*done < length) {
+        int64_t in = src_offset + (int64_t)*done;
+        ssize_t n = sendfile(dst_fd, src_fd, &in, length - *done);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        *done += (uint64_t)n;
+    }
+    return *done == length ? 0 : -1;
+}
+
+static int read_write_loop(int src_fd, int64_t src_offset, int dst_fd, uint64_t length, uint64_t *done) {
+    char *buf = (char *)malloc(COPY_CHUNK_SIZE);
+    if (!buf) return -1;
+    while (*done < length) {
+        size_t want = length - *done < COPY_CHUNK_SIZE ? (size_t)(length - *done) : COPY_CHUNK_SIZE;
+        ssize_t n = pread(src_fd, buf, want, src_offset + (int64_t)*done);
+        if (n <= 0) break;
+        ssize_t written = 0;
+        while (written < n) {
+            ssize_t w = pwrite(dst_fd, buf + written, (size_t)(n - written), (int64_t)(*done + (uint64_t)written));
+            if (w <= 0) {
+                free(buf);
+                return -1;
+            }
+            written += w;
+        }
+        *done += (uint64_t)n;
+    }
+    free(buf);
+    return *done == length ? 0 : -1;
+}
+
+// Copy length bytes from src_fd at src_offset to the start of dst_fd, trying reflink,
+// copy_file_range and sendfile before falling back to copying through user space.
+// Returns the CopyStrategy that moved the bulk of the data, or -1 on failure.
+int copy_fd_range(int src_fd, int64_t src_offset, int dst_fd, uint64_t length) {
+    struct stat src_st, dst_st;
+    if (fstat(src_fd, &src_st) != 0 || fstat(dst_fd, &dst_st) != 0) return -1;
+
+    unsigned disabled = disabled_strategies(src_st.st_dev, dst_st.st_dev);
+    int used = COPY_READ_WRITE;
+    uint64_t done = 0;
+    if (length == 0) return used;
+
+    if (IsLinux() && !(disabled & (1u << COPY_REFLINK))) {
+        if (reflink_range(src_fd, src_offset, dst_fd, length, dst_st.st_blksize, &done) != 0) {
+            if (errno != EINVAL && is_unsupported(errno)) disable_strategy(src_st.st_dev, dst_st.st_dev, COPY_REFLINK);
+        } else if (done > 0) {
+            used = COPY_REFLINK;
+        }
+    }
+
+    if (done < length && !(disabled & (1u << COPY_FILE_RANGE))) {
+        uint64_t before = done;
+        if (copy_file_range_loop(src_fd, src_offset, dst_fd, length, &done) != 0 && is_unsupported(errno)) {
+            disable_strategy(src_st.st_dev, dst_st.st_dev, COPY_FILE_RANGE);
+        }
+        if (used == COPY_READ_WRITE && done > before) used = COPY_FILE_RANGE;
+    }
+
+    if (done < length && !(disabled & (1u << COPY_SENDFILE))) {
+        uint64_t before = done;
+        if (sendfile_loop(src_fd, src_offset, dst_fd, length, &done) != 0 && is_unsupported(errno)) {
+            disable_strategy(src_st.st_dev, dst_st.st_dev, COPY_SENDFILE);
+        }
+        if (used == COPY_READ_WRITE && done > before) used = COPY_SENDFILE;
+    }
+
+    if (done < length && read_write_loop(src_fd, src_offset, dst_fd, length, &done) != 0) return -1;
+    return used;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "stdint.h"
+
+typedef enum {
+    COPY_REFLINK,
+    COPY_FILE_RANGE,
+    COPY_SENDFILE,
+    COPY_READ_WRITE,
+} CopyStrategy;
+
+const char* copy_strategy_name(int strategy);
+int copy_fd_range(int src_fd, int64_t src_offset, int dst_fd, uint64_t length);
@@ -21,59 +21,198 @@ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
 #include "libc/dce.h"
 #include "libc/nt/runtime.h"
+#include "pipeline.h"
+#include "readahead.h"
+#include "relocate.h"
+#include "trace.h"
 #include "utils.h"
+#include "verify.h"
+#include "versions.h"
+#include "zygote.h"
 
 // NOTE: Cosmopolitan linker script is hard-coded to change the
 // subsystem from TUI to GUI when GetMessage() is defined.
 void GetMessage() {}
 
-int main(int argc, char *argv[]) {
-    // read config, cd to unzip_path and set environment variables
-    init();
+enum {
+    STEP_UNZIP,
+    STEP_UV,
+    STEP_PYTHON,
+    STEP_PROJECT,
+    STEP_DEPENDENCIES,
+    STEP_RELOCATE,
+    STEP_COUNT,
+};
+
+static int extracted = 0;
+static int relocated = 0;
+static int created_project = 0;
+static char python_version[64] = {0};
+
+// unzip contents if not exists, verify and repair them otherwise
+static int unzip_step(PipelineStep *step) {
+    extracted = unzip();
+    // prefetch the files the entry reads at startup while the other steps run
+    start_readahead();
+    return 0;
+}
 
-    // unzip contents if not exists
-    unzip();
+static int install_uv_step(PipelineStep *step) {
+    if (path_exists(uv_path)) return 0;
+    console_log("uv not found, installing...\n");
+    int ret = install_uv();
+    if (!path_exists(uv_path)) return fail_step(step, "uv installation failed (exit code %d)", ret);
+    return 0;
+}
 
-    // install uv
-    if (!path_exists(uv_path)) {
-        console_log("uv not found, installing...\n");
-        install_uv();
+static int install_python_step(PipelineStep *step) {
+    find_python_path();
+    if (python_path[0] != '\0') return 0;
+    console_log("python not found, installing...\n");
+    int ret = install_python(python_version);
+    find_python_path();
+    if (python_path[0] == '\0') return fail_step(step, "python installation failed (exit code %d)", ret);
+    return 0;
+}
 
-        if (!path_exists(uv_path)) exit_with_message("ERROR: uv installation failed");
-    }
+// make sure pyproject.toml exists with dependencies
+static int create_project_step(PipelineStep *step) {
+    if (path_exists(pyproject_toml_path)) return 0;
+    console_log("pyproject.toml not found, creating new project...\n");
+    int ret = uv_init();
+    if (ret != 0) return fail_step(step, "uv init exited with %d", ret);
+    created_project = 1;
+    return 0;
+}
 
-    // install python
-    find_python_path();
-    if (python_path[0] == '\0') {
-        console_log("python not found, installing...\n");
-        install_python();
+static int add_dependencies_step(PipelineStep *step) {
+    if (!created_project || !path_exists(requirements_txt_path)) return 0;
+    console_log("add dependencies from requirements.txt...\n");
+    int ret = uv_add_dependencies();
+    if (ret != 0) return fail_step(step, "uv add exited with %d", ret);
+    return 0;
+}
 
-        find_python_path();
-        if (python_path[0] == '\0') exit_with_message("ERROR: python installation failed");
+// bundles shipping their synced .venv only need it moved to unzip_path, no uv sync
+static int relocate_venv_step(PipelineStep *step) {
+    relocated = relocate_venv();
+    if (relocated) write_sync_fingerprint();
+    return 0;
+}
+
+// uv and Python the executable carries are extracted by unzip, downloaded ones
+// can be fetched while the project is extracted. A downloaded Python only waits
+// for the project files when it has no .python-version to take the version from.
+// Either waits for unzip while its directory exists: the files a previous bundled
+// build extracted there may be removed as stale, the install would race with that.
+static void plan_setup_steps(PipelineStep *steps) {
+    int wait_uv = path_exists("/zip/uv") || path_exists(uv_dir);
+    int bundled_python = path_exists("/zip/python");
+    int wait_python = bundled_python || path_exists(python_dir);
+    if (!bundled_python) {
+        FILE *file = fopen("/zip/.python-version", "r");
+        if (file) {
+            if (!fgets(python_version, sizeof(python_version), file)) python_version[0] = '\0';
+            python_version[strcspn(python_version, " \t\r\n")] = '\0';
+            fclose(file);
+        }
     }
 
-    // make sure pyproject.toml exists with dependencies
-    if (!path_exists(pyproject_toml_path)) {
-        console_log("pyproject.toml not found, creating new project...\n");
-        uv_init();
+    steps[STEP_UNZIP] = (PipelineStep){.name = "unzip", .run = unzip_step};
+    steps[STEP_UV] = (PipelineStep){
+        .name = "install uv",
+        .run = install_uv_step,
+        .depends_on = wait_uv ? STEP_BIT(STEP_UNZIP) : 0,
+    };
+    steps[STEP_PYTHON] = (PipelineStep){
+        .name = "install python",
+        .run = install_python_step,
+        .depends_on = STEP_BIT(STEP_UV) | (wait_python || !python_version[0] ? STEP_BIT(STEP_UNZIP) : 0),
+    };
+    steps[STEP_PROJECT] = (PipelineStep){
+        .name = "create project",
+        .run = create_project_step,
+        .depends_on = STEP_BIT(STEP_UNZIP) | STEP_BIT(STEP_UV),
+    };
+    steps[STEP_DEPENDENCIES] = (PipelineStep){
+        .name = "add dependencies",
+        .run = add_dependencies_step,
+        .depends_on = STEP_BIT(STEP_PROJECT) | STEP_BIT(STEP_PYTHON),
+    };
+    // the sync fingerprint covers the Python path
+    steps[STEP_RELOCATE] = (PipelineStep){
+        .name = "relocate venv",
+        .run = relocate_venv_step,
+        .depends_on = STEP_BIT(STEP_UNZIP) | STEP_BIT(STEP_PYTHON),
+    };
+}
+
+int main(int argc, char *argv[]) {
+    // PYFUZE_TRACE=<file> records phase timings as a Chrome trace
+    trace_init();
 
-        if (path_exists(requirements_txt_path)) {
-            console_log("add dependencies from requirements.txt...\n");
-            uv_add_dependencies();
-        }
+    // read config, cd to unzip_path and set environment variables
+    uint64_t start = TRACE_START();
+    init();
+    TRACE_PHASE("init", start);
+
+    // one launcher at a time sets up unzip_path, the others wait and reuse its work
+    start = TRACE_START();
+    lock_setup();
+    TRACE_PHASE("wait for lock", start);
+
+    // extract, install uv and Python and create the project, overlapping what doesn't
+    // depend on each other
+    PipelineStep steps[STEP_COUNT];
+    plan_setup_steps(steps);
+    if (run_pipeline(steps, STEP_COUNT) > 0) exit_with_message("ERROR: setup of %s failed", config_unzip_path);
+
+    // uv sync, skipped while nothing it depends on has changed (PYFUZE_FORCE_SYNC=1 forces it)
+    start = TRACE_START();
+    int synced = sync_fingerprint_matches();
+    int setup_changed = extracted || relocated || !synced;
+    if (!synced && uv_sync(path_exists(uv_lock_path), !path_exists(pyvenv_cfg_path)) == 0) {
+        write_sync_fingerprint();
+        synced = 1;
     }
+    TRACE_PHASE("sync", start);
 
-    // uv sync
-    uv_sync(path_exists(uv_lock_path), !path_exists(pyvenv_cfg_path));
+    // the next launch's stat pass compares against the tree as this setup left it
+    if (setup_changed) {
+        start = TRACE_START();
+        save_extract_index();
+        TRACE_PHASE("save index", start);
+    }
+    unlock_setup();
+
+    // versioned extraction: point current at this build once it is complete and
+    // remove the versions no running process uses anymore
+    if (config_versioned && synced && publish_current_version()) {
+        start = TRACE_START();
+        gc_versions();
+        uv_cache_prune();
+        TRACE_PHASE("gc versions", start);
+    }
 
     // close allocated console
     if (alloc_console) close_console();
 
+    // hand the launch to a resident zygote with the modules preloaded (Unix only)
+    if (config_zygote) run_with_zygote(argc, argv);
+
+    // exec the venv python directly, no uv process and no waiting parent (Unix only)
+    if (config_direct_exec) exec_venv_python(argc, argv);
+
     // uv run
+    start = TRACE_START();
     int ret = uv_run(config_win_gui, argc, argv);
+    TRACE_PHASE("run", start);
+    trace_flush();
     if (IsWindows()) {
         ExitProcess((unsigned int)ret);
     } else {
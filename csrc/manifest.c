@@ -0,0 +1,187 @@
+#include "manifest.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define INITIAL_CAPACITY 256
+#define SHA256_HEX_LENGTH 64
+
+// Read the whole file into one NUL-terminated buffer
+static char* read_file(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return NULL;
+
+    size_t size = 0;
+    size_t capacity = 64 * 1024;
+    char* data = (char*)malloc(capacity + 1);
+    if (!data) {
+        fclose(file);
+        return NULL;
+    }
+    size_t n;
+    while ((n = fread(data + size, 1, capacity - size, file)) > 0) {
+        size += n;
+        if (size == capacity) {
+            char* new_data = (char*)realloc(data, capacity * 2 + 1);
+            if (!new_data) {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+    }
+    fclose(file);
+    data[size] = '\0';
+    return data;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const ManifestEntry*)a)->path, ((const ManifestEntry*)b)->path);
+}
+
+// The optional sha256 field is exactly 64 lowercase hex digits followed by a tab
+static int is_hash_field(const char* field) {
+    for (int i = 0; i < SHA256_HEX_LENGTH; i++) {
+        char c = field[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return 0;
+    }
+    return field[SHA256_HEX_LENGTH] == '\t';
+}
+
+// Parse a manifest written by the packager.
+// Each line is "<crc32 hex>\t<size>\t<mode octal>\t[<sha256 hex>\t]<path>[\t<source>]",
+// paths are relative to unzip_path. A deduplicated file names the source file
+// whose archive entry holds its content.
+// Entries point into one buffer and are sorted by path for lookups.
+Manifest* parse_manifest(const char* filename) {
+    char* data = read_file(filename);
+    if (!data) return NULL;
+
+    Manifest* manifest = (Manifest*)malloc(sizeof(Manifest));
+    if (!manifest) {
+        free(data);
+        return NULL;
+    }
+    manifest->data = data;
+    manifest->count = 0;
+    manifest->capacity = INITIAL_CAPACITY;
+    manifest->entries = (ManifestEntry*)malloc(sizeof(ManifestEntry) * manifest->capacity);
+    if (!manifest->entries) {
+        free(data);
+        free(manifest);
+        return NULL;
+    }
+
+    char* line = data;
+    while (*line) {
+        char* next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        } else {
+            next = line + strlen(line);
+        }
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r') line[len - 1] = '\0';
+
+        char* field = line;
+        char* end;
+        ManifestEntry entry;
+        entry.crc32 = (uint32_t)strtoul(field, &end, 16);
+        if (*end != '\t') goto skip;
+        entry.size = strtoull(end + 1, &end, 10);
+        if (*end != '\t') goto skip;
+        entry.mode = (uint32_t)strtoul(end + 1, &end, 8);
+        if (*end != '\t' || end[1] == '\0') goto skip;
+        entry.hash = NULL;
+        if (is_hash_field(end + 1)) {
+            entry.hash = end + 1;
+            end += SHA256_HEX_LENGTH + 1;
+            *end = '\0';
+            if (end[1] == '\0') goto skip;
+        }
+        entry.path = end + 1;
+        entry.source = strchr(entry.path, '\t');
+        if (entry.source) {
+            *entry.source++ = '\0';
+            if (*entry.source == '\0') entry.source = NULL;
+        }
+
+        // Expand capacity if needed
+        if (manifest->count >= manifest->capacity) {
+            size_t new_capacity = manifest->capacity * 2;
+            ManifestEntry* new_entries = (ManifestEntry*)realloc(manifest->entries, sizeof(ManifestEntry) * new_capacity);
+            if (!new_entries) {
+                free_manifest(manifest);
+                return NULL;
+            }
+            manifest->entries = new_entries;
+            manifest->capacity = new_capacity;
+        }
+        manifest->entries[manifest->count++] = entry;
+
+    skip:
+        line = next;
+    }
+
+    qsort(manifest->entries, manifest->count, sizeof(ManifestEntry), compare_entries);
+    return manifest;
+}
+
+// Build a manifest over the inline file index of a binary launch manifest.
+// Strings stay in the mapping, only the entry array is allocated.
+Manifest* manifest_from_config(const Config* config) {
+    size_t count = config_file_count(config);
+    if (count == 0) return NULL;
+
+    Manifest* manifest = (Manifest*)malloc(sizeof(Manifest));
+    if (!manifest) return NULL;
+    manifest->data = NULL;
+    manifest->count = 0;
+    manifest->capacity = count;
+    manifest->entries = (ManifestEntry*)malloc(sizeof(ManifestEntry) * count);
+    if (!manifest->entries) {
+        free(manifest);
+        return NULL;
+    }
+
+    int sorted = 1;
+    for (size_t i = 0; i < count; i++) {
+        ManifestEntry* entry = &manifest->entries[i];
+        const char* path;
+        const char* hash;
+        const char* source;
+        config_file_at(config, i, &path, &hash, &source, &entry->size, &entry->crc32, &entry->mode);
+        entry->path = (char*)path;
+        entry->hash = (char*)hash;
+        entry->source = (char*)source;
+        if (i > 0 && strcmp(manifest->entries[i - 1].path, path) > 0) sorted = 0;
+    }
+    manifest->count = count;
+
+    // the packager writes the index sorted, only reorder if it wasn't
+    if (!sorted) qsort(manifest->entries, manifest->count, sizeof(ManifestEntry), compare_entries);
+    return manifest;
+}
+
+// Binary search for the entry with the given path
+const ManifestEntry* find_manifest_entry(const Manifest* manifest, const char* path) {
+    if (!manifest || !path) return NULL;
+    ManifestEntry key;
+    key.path = (char*)path;
+    return (const ManifestEntry*)bsearch(&key, manifest->entries, manifest->count, sizeof(ManifestEntry), compare_entries);
+}
+
+int manifest_entry_equal(const ManifestEntry* a, const ManifestEntry* b) {
+    return a->size == b->size && a->crc32 == b->crc32 && a->mode == b->mode && strcmp(a->path, b->path) == 0;
+}
+
+// Free the Manifest and its resources
+void free_manifest(Manifest* manifest) {
+    if (!manifest) return;
+    free(manifest->entries);
+    free(manifest->data);
+    free(manifest);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "config.h"
+#include "stddef.h"
+#include "stdint.h"
+
+typedef struct {
+    char* path;
+    char* hash;
+    // file holding the same content in the archive, NULL if it has an entry of its own
+    char* source;
+    uint64_t size;
+    uint32_t crc32;
+    uint32_t mode;
+} ManifestEntry;
+
+typedef struct {
+    char* data;
+    ManifestEntry* entries;
+    size_t count;
+    size_t capacity;
+} Manifest;
+
+Manifest* parse_manifest(const char* filename);
+Manifest* manifest_from_config(const Config* config);
+const ManifestEntry* find_manifest_entry(const Manifest* manifest, const char* path);
+int manifest_entry_equal(const ManifestEntry* a, const ManifestEntry* b);
+void free_manifest(Manifest* manifest);
@@ -0,0 +1,113 @@
+#include "pipeline.h"
+
+#include "stdarg.h"
+#include "stdio.h"
+#include "trace.h"
+#include "utils.h"
+
+#define STEP_PENDING 0
+#define STEP_RUNNING 1
+#define STEP_DONE 2
+#define STEP_FAILED 3
+#define STEP_SKIPPED 4
+
+// unzip() walks directories recursively with PATH_MAX buffers on the stack
+#define STEP_STACK_SIZE (1024 * 1024)
+
+static pthread_mutex_t pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pipeline_changed = PTHREAD_COND_INITIALIZER;
+
+int fail_step(PipelineStep *step, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(step->error, sizeof(step->error), format, args);
+    va_end(args);
+    return 1;
+}
+
+static void *run_step(void *arg) {
+    PipelineStep *step = arg;
+    uint64_t start = TRACE_START();
+    int failed = step->run(step) != 0;
+    TRACE_PHASE(step->name, start);
+
+    pthread_mutex_lock(&pipeline_lock);
+    step->state = failed ? STEP_FAILED : STEP_DONE;
+    pthread_cond_signal(&pipeline_changed);
+    pthread_mutex_unlock(&pipeline_lock);
+    return NULL;
+}
+
+// Start every step whose dependencies are done and skip the ones behind a failed
+// step. Called with the lock held, returns the number of steps still running.
+static int schedule_steps(PipelineStep *steps, int count, pthread_attr_t *attr) {
+    int progress;
+    do {
+        progress = 0;
+        for (int i = 0; i < count; i++) {
+            PipelineStep *step = &steps[i];
+            if (step->state != STEP_PENDING) continue;
+
+            int ready = 1;
+            int blocked = 0;
+            for (int j = 0; j < i; j++) {
+                if (!(step->depends_on & STEP_BIT(j))) continue;
+                if (steps[j].state == STEP_FAILED || steps[j].state == STEP_SKIPPED) blocked = 1;
+                if (steps[j].state != STEP_DONE) ready = 0;
+            }
+            if (blocked) {
+                step->state = STEP_SKIPPED;
+                progress = 1;
+            } else if (ready) {
+                step->state = STEP_RUNNING;
+                step->threaded = pthread_create(&step->thread, attr, run_step, step) == 0;
+                if (!step->threaded) {
+                    pthread_mutex_unlock(&pipeline_lock);
+                    run_step(step);
+                    pthread_mutex_lock(&pipeline_lock);
+                }
+                progress = 1;
+            }
+        }
+    } while (progress);
+
+    int running = 0;
+    for (int i = 0; i < count; i++) {
+        if (steps[i].state == STEP_RUNNING) running++;
+    }
+    return running;
+}
+
+// Run the setup steps as a dependency graph: each step starts on its own thread as
+// soon as the steps it depends on are done, so downloads and extraction overlap.
+// A failed step doesn't stop the independent ones, its dependents are skipped.
+// Returns the number of failed steps after reporting every one of them.
+int run_pipeline(PipelineStep *steps, int count) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STEP_STACK_SIZE);
+
+    pthread_mutex_lock(&pipeline_lock);
+    for (int i = 0; i < count; i++) {
+        steps[i].state = STEP_PENDING;
+        steps[i].threaded = 0;
+        steps[i].error[0] = '\0';
+    }
+    while (schedule_steps(steps, count, &attr) > 0) {
+        pthread_cond_wait(&pipeline_changed, &pipeline_lock);
+    }
+    pthread_mutex_unlock(&pipeline_lock);
+    pthread_attr_destroy(&attr);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (steps[i].threaded) pthread_join(steps[i].thread, NULL);
+        if (steps[i].state == STEP_FAILED) {
+            console_log("ERROR: %s failed: %s\n", steps[i].name, steps[i].error[0] ? steps[i].error : "unknown error");
+            failed++;
+        } else if (steps[i].state == STEP_SKIPPED) {
+            console_log("%s skipped\n", steps[i].name);
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "pthread.h"
+
+#define MAX_STEP_ERROR 256
+
+// Bit for steps[index] in PipelineStep.depends_on
+#define STEP_BIT(index) (1u << (index))
+
+typedef struct PipelineStep PipelineStep;
+
+struct PipelineStep {
+    const char *name;
+    // returns 0 on success, fail_step() otherwise
+    int (*run)(PipelineStep *step);
+    // steps this one waits for, only earlier steps of the array
+    unsigned depends_on;
+    int state;
+    int threaded;
+    pthread_t thread;
+    char error[MAX_STEP_ERROR];
+};
+
+int fail_step(PipelineStep *step, const char *format, ...);
+int run_pipeline(PipelineStep *steps, int count);
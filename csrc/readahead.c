@@ -0,0 +1,90 @@
+#include "readahead.h"
+
+#include "fcntl.h"
+#include "libc/dce.h"
+#include "limits.h"
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/wait.h"
+#include "trace.h"
+#include "unistd.h"
+#include "utils.h"
+
+#define READAHEAD_BUFFER_SIZE (256 * 1024)
+
+// Written by the packager (--train-readahead): the files a training run of the
+// entry opened, relative to unzip_path, in the order it first opened them
+const char *zip_readahead_path = "/zip/.pyfuze_readahead.txt";
+
+static void prefetch_file(const char *path, char *buffer) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return;
+    // asks the kernel to start reading without waiting for it, where that isn't
+    // supported reading the file through pulls it in just the same
+    if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) != 0) {
+        while (read(fd, buffer, READAHEAD_BUFFER_SIZE) > 0) {
+        }
+    }
+    close(fd);
+}
+
+// Runs detached and may outlive the launcher's trace and console, so it reports nothing
+static void *prefetch_files(void *arg) {
+    FILE *list = arg;
+    char *buffer = malloc(READAHEAD_BUFFER_SIZE);
+    char line[PATH_MAX];
+    if (buffer) {
+        while (fgets(line, sizeof(line), list)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (!line[0]) continue;
+            prefetch_file(line, buffer);
+        }
+        free(buffer);
+    }
+    fclose(list);
+    return NULL;
+}
+
+// Pull the runtime working set into the page cache while the rest of the setup
+// runs, so the interpreter's imports hit memory instead of the disk. On Unix this
+// runs in a detached process, because direct exec would end a thread too early.
+void start_readahead() {
+    FILE *list = fopen(zip_readahead_path, "r");
+    if (!list) return;
+    uint64_t start = TRACE_START();
+    debug_log("prefetching the files of %s in the background\n", zip_readahead_path);
+
+    if (IsWindows()) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, prefetch_files, list) != 0) {
+            fclose(list);
+            return;
+        }
+        pthread_detach(thread);
+        TRACE_PHASE("start readahead", start);
+        return;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (fork() == 0) {
+            // don't hold a caller's pipes open until the prefetch is done
+            int null_fd = open("/dev/null", O_RDWR);
+            if (null_fd != -1) {
+                dup2(null_fd, 0);
+                dup2(null_fd, 1);
+                dup2(null_fd, 2);
+                if (null_fd > 2) close(null_fd);
+            }
+            prefetch_files(list);
+        }
+        _exit(0);
+    }
+    fclose(list);
+    if (pid > 0) waitpid(pid, NULL, 0);
+    TRACE_PHASE("start readahead", start);
+}
@@ -0,0 +1,191 @@
+#include "relocate.h"
+
+#include "libc/dce.h"
+#include "libc/errno.h"
+#include "limits.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "unistd.h"
+#include "utils.h"
+
+#define MAX_RELOCATE_PREFIXES 4
+#define MAX_RELOCATE_LINE (PATH_MAX * 2 + 16)
+
+// Written by the packager for bundles that ship their synced .venv (--ship-venv)
+const char *zip_relocate_path = "/zip/.pyfuze_relocate.txt";
+// "<build id>\n<unzip path>" of the last relocation
+const char *relocate_stamp_path = ".venv/.pyfuze_relocated";
+
+typedef struct {
+    char paths[MAX_RELOCATE_PREFIXES][PATH_MAX];
+    size_t lengths[MAX_RELOCATE_PREFIXES];
+    size_t count;
+} Prefixes;
+
+// unzip_path the way the interpreter and scripts will see it
+static void current_prefix(char *prefix, size_t prefix_size) {
+    if (!getcwd(prefix, prefix_size)) exit_with_message("getcwd failed");
+    if (IsWindows()) {
+        convert_to_windows_path(prefix);
+        for (char *p = prefix; *p; p++) {
+            if (*p == '/') *p = '\\';
+        }
+    }
+}
+
+static size_t match_prefix(const Prefixes *prefixes, const char *data, size_t remaining) {
+    for (size_t i = 0; i < prefixes->count; i++) {
+        if (prefixes->lengths[i] <= remaining && memcmp(data, prefixes->paths[i], prefixes->lengths[i]) == 0) {
+            return prefixes->lengths[i];
+        }
+    }
+    return 0;
+}
+
+// Replace every build directory prefix in a text file with unzip_path, writing a
+// temporary file and renaming it over the original
+static void rewrite_file(const char *path, const Prefixes *prefixes, const char *new_prefix) {
+    FILE *file = fopen(path, "rb");
+    if (!file) exit_with_message("Failed to open %s", path);
+    struct stat st;
+    fstat(fileno(file), &st);
+    char *data = malloc((size_t)st.st_size + 1);
+    if (!data) exit_with_message("Out of memory reading %s", path);
+    size_t size = fread(data, 1, (size_t)st.st_size, file);
+    fclose(file);
+
+    size_t new_length = strlen(new_prefix);
+    size_t occurrences = 0;
+    for (size_t i = 0; i < size; i++) {
+        size_t matched = match_prefix(prefixes, data + i, size - i);
+        if (matched) {
+            occurrences++;
+            i += matched - 1;
+        }
+    }
+    if (occurrences == 0) {
+        free(data);
+        return;
+    }
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.pyfuze-tmp.%d", path, (int)getpid());
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) exit_with_message("Failed to create %s", tmp_path);
+    size_t start = 0;
+    for (size_t i = 0; i < size;) {
+        size_t matched = match_prefix(prefixes, data + i, size - i);
+        if (!matched) {
+            i++;
+            continue;
+        }
+        fwrite(data + start, 1, i - start, out);
+        fwrite(new_prefix, 1, new_length, out);
+        i += matched;
+        start = i;
+    }
+    fwrite(data + start, 1, size - start, out);
+    free(data);
+    if (fclose(out) != 0) exit_with_message("Failed to write %s", tmp_path);
+
+    chmod(tmp_path, st.st_mode & 07777);
+    if (rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        exit_with_message("Failed to replace %s", path);
+    }
+    debug_log("relocated %zu paths in %s\n", occurrences, path);
+}
+
+// Files extracted again carry the build paths, the next relocate_venv() rewrites them
+void invalidate_relocation() {
+    unlink(relocate_stamp_path);
+}
+
+// "@" at the start of the target stands for unzip_path
+static void make_link(const char *path, const char *target, const char *new_prefix) {
+    char resolved[PATH_MAX];
+    if (target[0] == '@') {
+        snprintf(resolved, sizeof(resolved), "%s/%s", new_prefix, target + 1);
+    } else {
+        snprintf(resolved, sizeof(resolved), "%s", target);
+    }
+
+    unlink(path);
+    if (symlink(resolved, path) == 0) return;
+
+    // no symlink permission (Windows), fall back to a copy of a file target
+    if (target[0] != '@') {
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s", path);
+        char *last_slash = strrchr(dir, '/');
+        if (last_slash) *last_slash = '\0';
+        snprintf(resolved, sizeof(resolved), "%s/%s", last_slash ? dir : ".", target);
+    }
+    copy_file(resolved, path);
+}
+
+// Move a .venv synced at build time from the packager's build directory to unzip_path:
+// rewrite pyvenv.cfg home, script shebangs and activation scripts, and recreate
+// the symlinks the zip couldn't hold. Runs again after every upgrade, since changed
+// files are extracted with the build paths in them. Returns 1 if it relocated.
+int relocate_venv() {
+    FILE *list = fopen(zip_relocate_path, "r");
+    if (!list) return 0;
+
+    char new_prefix[PATH_MAX];
+    char build_id[MAX_BUILD_ID_LENGTH] = {0};
+    char stamp[MAX_BUILD_ID_LENGTH + PATH_MAX + 2];
+    char existing_stamp[sizeof(stamp)] = {0};
+    current_prefix(new_prefix, sizeof(new_prefix));
+    read_build_id(build_id_name, build_id);
+    snprintf(stamp, sizeof(stamp), "%s\n%s", build_id, new_prefix);
+
+    FILE *file = fopen(relocate_stamp_path, "r");
+    if (file) {
+        fread(existing_stamp, 1, sizeof(existing_stamp) - 1, file);
+        fclose(file);
+    }
+    if (strcmp(stamp, existing_stamp) == 0) {
+        fclose(list);
+        return 0;
+    }
+
+    Prefixes prefixes = {0};
+    size_t files = 0;
+    size_t links = 0;
+    char line[MAX_RELOCATE_LINE];
+    while (fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *kind = line;
+        char *path = strchr(line, '\t');
+        if (!path) continue;
+        *path++ = '\0';
+
+        if (strcmp(kind, "prefix") == 0) {
+            if (prefixes.count == MAX_RELOCATE_PREFIXES) continue;
+            snprintf(prefixes.paths[prefixes.count], PATH_MAX, "%s", path);
+            prefixes.lengths[prefixes.count] = strlen(path);
+            prefixes.count++;
+        } else if (strcmp(kind, "file") == 0) {
+            rewrite_file(path, &prefixes, new_prefix);
+            files++;
+        } else if (strcmp(kind, "link") == 0) {
+            char *target = strchr(path, '\t');
+            if (!target) continue;
+            *target++ = '\0';
+            make_link(path, target, new_prefix);
+            links++;
+        }
+    }
+    fclose(list);
+
+    file = fopen(relocate_stamp_path, "w");
+    if (!file) exit_with_message("Failed to write %s", relocate_stamp_path);
+    fputs(stamp, file);
+    fclose(file);
+
+    console_log("relocated .venv to %s (%zu files, %zu links)\n", new_prefix, files, links);
+    return 1;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+int relocate_venv();
+void invalidate_relocation();
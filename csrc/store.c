@@ -0,0 +1,115 @@
+#include "store.h"
+
+#include "dirent.h"
+#include "libc/dce.h"
+#include "libc/errno.h"
+#include "limits.h"
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "time.h"
+#include "unistd.h"
+#include "utils.h"
+
+// objects touched more recently than this may be mid-publish by another launcher
+#define STORE_GC_GRACE_SECONDS 600
+
+static char store_dir[PATH_MAX] = {0};
+
+// Resolve the host-wide object store directory.
+// PYFUZE_STORE_DIR overrides $XDG_CACHE_HOME/pyfuze/objects (or %LOCALAPPDATA% on Windows).
+void init_store() {
+    const char *dir = getenv("PYFUZE_STORE_DIR");
+    if (dir && dir[0]) {
+        snprintf(store_dir, sizeof(store_dir), "%s", dir);
+    } else if (IsWindows() && (dir = getenv("LOCALAPPDATA")) != NULL) {
+        snprintf(store_dir, sizeof(store_dir), "%s/pyfuze/objects", dir);
+    } else if ((dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0]) {
+        snprintf(store_dir, sizeof(store_dir), "%s/pyfuze/objects", dir);
+    } else if ((dir = getenv("HOME")) != NULL && dir[0]) {
+        snprintf(store_dir, sizeof(store_dir), "%s/.cache/pyfuze/objects", dir);
+    } else {
+        console_log("no cache directory for the shared store, extracting privately\n");
+        return;
+    }
+    mkdir_recursive(store_dir);
+}
+
+int store_enabled() {
+    return store_dir[0] != '\0';
+}
+
+// Objects are named after their content hash and mode, since every hardlink shares one inode
+static void object_path(char *path, size_t path_size, const char *hash, uint32_t mode) {
+    snprintf(path, path_size, "%s/%.2s/%s-%o", store_dir, hash, hash + 2, mode & 07777);
+}
+
+// Write the object once via a temporary file and rename, so concurrent launchers
+// never see a partial object.
+static void publish_object(const char *object, const char *hash, const char *src_path) {
+    char dir[PATH_MAX];
+    char tmp[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/%.2s", store_dir, hash);
+    mkdir_recursive(dir);
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d.%lx", object, (int)getpid(), (unsigned long)pthread_self());
+    copy_file(src_path, tmp);
+    if (rename(tmp, object) != 0) {
+        unlink(tmp);
+        exit_with_message("Failed to publish %s", object);
+    }
+}
+
+// Materialize dst_path from the store, adding the object first if this is the
+// first app on the host to ship it. Prefers a hardlink and falls back to a
+// (reflink capable) copy when the store is on another filesystem.
+void store_materialize(const char *hash, uint32_t mode, const char *src_path, const char *dst_path) {
+    char object[PATH_MAX];
+    object_path(object, sizeof(object), hash, mode);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!path_exists(object)) publish_object(object, hash, src_path);
+        if (link_file(object, dst_path) == 0) return;
+        // a concurrent gc may have pruned the object between publish and link
+        if (errno != ENOENT) break;
+    }
+    copy_file(object, dst_path);
+}
+
+// Remove objects no app links to anymore: the link count is the reference count,
+// an object only the store holds has st_nlink == 1.
+void store_gc() {
+    if (!store_enabled()) return;
+
+    DIR *root = opendir(store_dir);
+    if (!root) return;
+
+    time_t now = time(NULL);
+    size_t removed = 0;
+    char dir_path[PATH_MAX];
+    char object[PATH_MAX];
+    struct dirent *ent;
+    while ((ent = readdir(root)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        snprintf(dir_path, sizeof(dir_path), "%s/%s", store_dir, ent->d_name);
+
+        DIR *d = opendir(dir_path);
+        if (!d) continue;
+        struct dirent *obj;
+        while ((obj = readdir(d)) != NULL) {
+            if (obj->d_name[0] == '.') continue;
+            snprintf(object, sizeof(object), "%s/%s", dir_path, obj->d_name);
+
+            struct stat st;
+            if (lstat(object, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+            if (st.st_nlink > 1 || now - st.st_ctime < STORE_GC_GRACE_SECONDS) continue;
+            if (unlink(object) == 0) removed++;
+        }
+        closedir(d);
+        rmdir(dir_path);
+    }
+    closedir(root);
+
+    if (removed) debug_log("removed %zu unreferenced objects from %s\n", removed, store_dir);
+}
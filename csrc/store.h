@@ -0,0 +1,8 @@
+#pragma once
+
+#include "stdint.h"
+
+void init_store();
+int store_enabled();
+void store_materialize(const char* hash, uint32_t mode, const char* src_path, const char* dst_path);
+void store_gc();
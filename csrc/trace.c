@@ -0,0 +1,154 @@
+#include "trace.h"
+
+#include "limits.h"
+#include "pthread.h"
+#include "stdatomic.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#define MAX_TRACE_EVENTS 256
+#define MAX_TRACE_NAME 96
+
+typedef struct {
+    char name[MAX_TRACE_NAME];
+    const char *category;
+    uint64_t start;
+    uint64_t duration;
+    int exit_code;
+    int tid;
+} TraceEvent;
+
+int trace_on = 0;
+
+static char trace_path[PATH_MAX] = {0};
+static uint64_t trace_origin = 0;
+static TraceEvent events[MAX_TRACE_EVENTS];
+static size_t event_count = 0;
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic uint64_t files_extracted = 0;
+static _Atomic uint64_t bytes_extracted = 0;
+static int flushed = 0;
+// Small per-thread ids for the "tid" field, so events of parallel pipeline steps get
+// their own tracks. The main thread takes the first one in trace_init().
+static _Atomic int next_tid = 1;
+static _Thread_local int thread_tid = 0;
+
+static int current_tid() {
+    if (thread_tid == 0) thread_tid = atomic_fetch_add(&next_tid, 1);
+    return thread_tid;
+}
+
+// Microseconds on the monotonic clock, the unit Chrome trace events use
+uint64_t trace_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// PYFUZE_TRACE=<file> enables tracing, relative paths are resolved against the
+// directory the launcher was invoked from since init() changes directory later.
+void trace_init() {
+    const char *path = getenv("PYFUZE_TRACE");
+    if (!path || !path[0]) return;
+
+    if (path[0] == '/' || (path[0] && path[1] == ':')) {
+        snprintf(trace_path, sizeof(trace_path), "%s", path);
+    } else {
+        char cwd[PATH_MAX] = {0};
+        if (!getcwd(cwd, sizeof(cwd))) return;
+        snprintf(trace_path, sizeof(trace_path), "%s/%s", cwd, path);
+    }
+    trace_origin = trace_now();
+    current_tid();
+    trace_on = 1;
+    atexit(trace_flush);
+}
+
+static void add_event(const char *name, const char *category, uint64_t start, int exit_code) {
+    uint64_t end = trace_now();
+    pthread_mutex_lock(&events_lock);
+    if (event_count < MAX_TRACE_EVENTS) {
+        TraceEvent *event = &events[event_count++];
+        snprintf(event->name, sizeof(event->name), "%s", name);
+        event->category = category;
+        event->start = start;
+        event->duration = end - start;
+        event->exit_code = exit_code;
+        event->tid = current_tid();
+    }
+    pthread_mutex_unlock(&events_lock);
+}
+
+void trace_phase(const char *name, uint64_t start) {
+    add_event(name, "phase", start, 0);
+}
+
+// Name spawned commands after the program and its subcommand, e.g. "uv sync"
+void trace_command(const char *const argv[], uint64_t start, int exit_code) {
+    if (!trace_on) return;
+    const char *program = strrchr(argv[0], '/');
+    program = program ? program + 1 : argv[0];
+    char name[MAX_TRACE_NAME];
+    snprintf(name, sizeof(name), "%s %s", program, argv[1] ? argv[1] : "");
+    add_event(name, "command", start, exit_code);
+}
+
+void trace_count_file(uint64_t bytes) {
+    if (!trace_on) return;
+    atomic_fetch_add(&files_extracted, 1);
+    atomic_fetch_add(&bytes_extracted, bytes);
+}
+
+static void write_json_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', file);
+            fputc(*s, file);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(file, "\\u%04x", *s);
+        } else {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Write everything recorded so far as a Chrome trace-event JSON file.
+// Called at exit and right before the launcher execs or exits the process directly.
+void trace_flush() {
+    if (!trace_on || flushed) return;
+    flushed = 1;
+
+    FILE *file = fopen(trace_path, "w");
+    if (!file) return;
+
+    int pid = (int)getpid();
+    fputs("{\"traceEvents\":[\n", file);
+    pthread_mutex_lock(&events_lock);
+    for (size_t i = 0; i < event_count; i++) {
+        TraceEvent *event = &events[i];
+        fputs("{\"name\":", file);
+        write_json_string(file, event->name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d",
+                event->category,
+                (unsigned long long)(event->start - trace_origin),
+                (unsigned long long)event->duration,
+                pid, event->tid);
+        if (strcmp(event->category, "command") == 0) {
+            fprintf(file, ",\"args\":{\"exit_code\":%d}", event->exit_code);
+        }
+        fputs("},\n", file);
+    }
+    pthread_mutex_unlock(&events_lock);
+    fprintf(file, "{\"name\":\"extracted\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%d,\"args\":{\"files\":%llu,\"bytes\":%llu}}\n",
+            (unsigned long long)(trace_now() - trace_origin),
+            pid,
+            (unsigned long long)atomic_load(&files_extracted),
+            (unsigned long long)atomic_load(&bytes_extracted));
+    fputs("]}\n", file);
+    fclose(file);
+}
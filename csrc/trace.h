@@ -0,0 +1,19 @@
+#pragma once
+
+#include "stdint.h"
+
+extern int trace_on;
+
+void trace_init();
+uint64_t trace_now();
+void trace_phase(const char* name, uint64_t start);
+void trace_command(const char* const argv[], uint64_t start, int exit_code);
+void trace_count_file(uint64_t bytes);
+void trace_flush();
+
+// Only read the clock while tracing, so the instrumentation stays compiled in for free
+#define TRACE_START() (trace_on ? trace_now() : 0)
+#define TRACE_PHASE(name, start) \
+    do {                         \
+        if (trace_on) trace_phase(name, start); \
+    } while (0)
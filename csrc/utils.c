@@ -2,6 +2,8 @@
 
 #include "config.h"
 #include "dirent.h"
+#include "extract.h"
+#include "fastcopy.h"
 #include "libc/dce.h"
 #include "libc/errno.h"
 #include "libc/nt/console.h"
@@ -12,21 +14,46 @@
 #include "libc/nt/synchronization.h"
 #include "libc/x/x.h"
 #include "limits.h"
+#include "manifest.h"
+#include "pthread.h"
 #include "spawn.h"
 #include "stdarg.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "store.h"
 #include "string.h"
+#include "sys/file.h"
 #include "sys/stat.h"
+#include "time.h"
+#include "trace.h"
 #include "unistd.h"
+#include "verify.h"
+#include "versions.h"
 #include "windowsesque.h"
+#include "zip.h"
 
-#define MAX_BUILD_ID_LENGTH 128
+#define SYNC_FINGERPRINT_LENGTH 32
 const char *build_id_name = ".build_id.txt";
 const char *zip_build_id_path = "/zip/.build_id.txt";
 
+const char *sync_stamp_name = ".uv_sync_stamp";
+
+// held while unzip_path is extracted, uv and python are installed and the venv is synced
+const char *setup_lock_name = ".pyfuze.lock";
+#define DEFAULT_LOCK_TIMEOUT_SECONDS 600
+static int setup_lock_fd = -1;
+
+const char *manifest_name = ".pyfuze_manifest.txt";
+const char *zip_manifest_path = "/zip/.pyfuze_manifest.txt";
+
 const char *config_name = ".pyfuze_config.txt";
 const char *zip_config_path = "/zip/.pyfuze_config.txt";
+const char *binary_config_name = ".pyfuze_config.bin";
+const char *relocate_name = ".pyfuze_relocate.txt";
+const char *readahead_name = ".pyfuze_readahead.txt";
+
+// kept mapped for the whole run, unzip() reads its file index
+static Config *launch_config = NULL;
 
 int attach_console = 0;
 int alloc_console = 0;
@@ -41,6 +68,7 @@ const char *src_dir = "src";
 const char *pyproject_toml_path = "pyproject.toml";
 const char *requirements_txt_path = "requirements.txt";
 const char *uv_lock_path = "uv.lock";
+const char *pycache_dir = "pycache";
 
 char uv_path[PATH_MAX] = {0};
 char python_path[PATH_MAX] = {0};
@@ -50,11 +78,28 @@ char config_uv_install_script_windows[PATH_MAX] = {0};
 char config_uv_install_script_unix[PATH_MAX] = {0};
 char config_entry[PATH_MAX] = {0};
 int config_win_gui = 0;
-
-char cmdline[8192];
+int config_extract_threads = 0;
+int config_direct_exec = 0;
+int config_shared_store = 0;
+int config_src_in_zip = 0;
+int config_versioned = 0;
+int config_compile_bytecode = 0;
+int config_optimize = 0;
+int config_zygote = 0;
+int config_zygote_idle_timeout = 300;
+char config_zygote_preload[PATH_MAX] = {0};
+
+// Windows command lines are built in a buffer of this size, per call so setup steps
+// running on different threads don't share one
+#define MAX_CMDLINE 8192
+
+// setup steps log from several threads, only the first one attaches
+static pthread_mutex_t console_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void windows_attach_or_alloc_console() {
-    if (IsWindows() && config_win_gui && !attach_console) {
+    if (!IsWindows() || !config_win_gui) return;
+    pthread_mutex_lock(&console_lock);
+    if (!attach_console) {
         attach_console = 1;
         if (!AttachConsole(kNtAttachParentProcess)) {
             alloc_console = 1;
@@ -63,13 +108,28 @@ void windows_attach_or_alloc_console() {
         freopen("CONOUT$", "w", stdout);
         freopen("CONOUT$", "w", stderr);
     }
+    pthread_mutex_unlock(&console_lock);
 }
 
-void console_log(const char *format, ...) {
+static void console_log_v(const char *format, va_list args) {
     windows_attach_or_alloc_console();
+    vprintf(format, args);
+}
+
+void console_log(const char *format, ...) {
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    console_log_v(format, args);
+    va_end(args);
+}
+
+// Verbose output for diagnosing launches, enabled with PYFUZE_DEBUG=1
+void debug_log(const char *format, ...) {
+    const char *debug = getenv("PYFUZE_DEBUG");
+    if (!debug || strcmp(debug, "1") != 0) return;
+    va_list args;
+    va_start(args, format);
+    console_log_v(format, args);
     va_end(args);
 }
 
@@ -81,7 +141,11 @@ void close_console() {
     FreeConsole();
 }
 
+// extraction workers may fail concurrently, only the first one reports and exits
+static pthread_mutex_t exit_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void exit_with_message(const char *format, ...) {
+    pthread_mutex_lock(&exit_lock);
     config_win_gui = 1;
     windows_attach_or_alloc_console();
     va_list args;
@@ -128,17 +192,55 @@ void find_python_path() {
     }
 }
 
+// Optional integer settings, missing in bundles built by older versions
+static int get_config_int(const Config *config, const char *key, int default_value) {
+    const char *value = get_config_value(config, key);
+    return value ? atoi(value) : default_value;
+}
+
+static void copy_config_string(const Config *config, const char *key, char *dst, size_t dst_size) {
+    const char *value = get_config_value(config, key);
+    if (!value) exit_with_message("Missing %s in %s", key, config_name);
+    if (strlen(value) >= dst_size) exit_with_message("Value of %s is too long in %s", key, config_name);
+    strcpy(dst, value);
+}
+
+// Map the binary launch manifest straight out of the executable, NULL if it isn't there
+static Config *map_launch_config() {
+    const ZipArchive *archive = open_self_zip();
+    const ZipEntry *entry = find_zip_entry(archive, binary_config_name);
+    if (!entry || entry->method != ZIP_METHOD_STORED) return NULL;
+    int64_t offset = zip_entry_data_offset(archive, entry);
+    if (offset < 0) return NULL;
+    return map_config(archive->fd, offset, entry->size);
+}
+
+// Prefer the binary launch manifest, the text config is the fallback
 Config *read_config() {
-    Config *config = parse_config(zip_config_path);
+    Config *config = map_launch_config();
+    if (!config) config = parse_config(zip_config_path);
     if (!config) {
         exit_with_message("Failed to parse %s", zip_config_path);
     }
 
-    strcpy(config_unzip_path, get_config_value(config, "unzip_path"));
-    strcpy(config_uv_install_script_windows, get_config_value(config, "uv_install_script_windows"));
-    strcpy(config_uv_install_script_unix, get_config_value(config, "uv_install_script_unix"));
-    strcpy(config_entry, get_config_value(config, "entry"));
-    config_win_gui = atoi(get_config_value(config, "win_gui"));
+    copy_config_string(config, "unzip_path", config_unzip_path, sizeof(config_unzip_path));
+    copy_config_string(config, "uv_install_script_windows", config_uv_install_script_windows, sizeof(config_uv_install_script_windows));
+    copy_config_string(config, "uv_install_script_unix", config_uv_install_script_unix, sizeof(config_uv_install_script_unix));
+    copy_config_string(config, "entry", config_entry, sizeof(config_entry));
+    config_win_gui = get_config_int(config, "win_gui", 0);
+
+    // 0 means one extraction thread per core
+    config_extract_threads = get_config_int(config, "extract_threads", 0);
+    config_direct_exec = get_config_int(config, "direct_exec", 0);
+    config_shared_store = get_config_int(config, "shared_store", 0);
+    config_src_in_zip = get_config_int(config, "src_in_zip", 0);
+    config_versioned = get_config_int(config, "versioned", 0);
+    config_compile_bytecode = get_config_int(config, "compile_bytecode", 0);
+    config_optimize = get_config_int(config, "optimize", 0);
+    config_zygote = get_config_int(config, "zygote", 0);
+    config_zygote_idle_timeout = get_config_int(config, "zygote_idle_timeout", 300);
+    const char *preload = get_config_value(config, "zygote_preload");
+    snprintf(config_zygote_preload, sizeof(config_zygote_preload), "%s", preload ? preload : "");
 
     return config;
 }
@@ -151,7 +253,7 @@ void convert_to_windows_path(char *path) {
 }
 
 void init() {
-    Config *config = read_config();
+    Config *config = launch_config = read_config();
 
     // pass invoke dir to python
     char invoke_dir[PATH_MAX] = {0};
@@ -168,6 +270,9 @@ void init() {
     mkdir_recursive(config_unzip_path);
     chdir(config_unzip_path);
 
+    // each build gets its own <unzip_path>/<build id> directory
+    if (config_versioned) enter_version_dir();
+
     // set environment variables
     set_env("UV_CACHE_DIR", cache_dir);
     set_env("UV_UNMANAGED_INSTALL", uv_dir);
@@ -184,9 +289,9 @@ void init() {
     }
     set_env("PYFUZE_EXECUTABLE_PATH", executable_path);
 
-    for (size_t i = 0; i < config->count; i++) {
-        char *key = config->items[i].key;
-        char *value = config->items[i].value;
+    for (size_t i = 0; i < config_item_count(config); i++) {
+        const char *key = config_key_at(config, i);
+        const char *value = config_value_at(config, i);
         if (strncmp(key, "env_", 4) != 0) {
             continue;
         }
@@ -194,26 +299,146 @@ void init() {
         set_env(key, value);
     }
 
-    free_config(config);
+    // bytecode shipped in the bundle was compiled at this optimization level
+    if (config_optimize > 0 && !getenv("PYTHONOPTIMIZE")) {
+        char level[16];
+        snprintf(level, sizeof(level), "%d", config_optimize);
+        set_env("PYTHONOPTIMIZE", level);
+    }
+
+    // keep bytecode compiled at runtime in one tree under unzip_path, where it survives
+    // re-extraction and venv reinstalls. Not for bundles shipping their own bytecode,
+    // with a prefix set Python ignores __pycache__ directories.
+    if (!config_compile_bytecode && !getenv("PYTHONPYCACHEPREFIX")) {
+        char pycache_prefix[PATH_MAX] = {0};
+        getcwd(pycache_prefix, sizeof(pycache_prefix));
+        if (IsWindows()) {
+            convert_to_windows_path(pycache_prefix);
+        }
+        strncat(pycache_prefix, "/", sizeof(pycache_prefix) - strlen(pycache_prefix) - 1);
+        strncat(pycache_prefix, pycache_dir, sizeof(pycache_prefix) - strlen(pycache_prefix) - 1);
+        set_env("PYTHONPYCACHEPREFIX", pycache_prefix);
+    }
+
+    // import the application modules straight from the executable
+    if (config_src_in_zip) {
+        char pythonpath[PATH_MAX * 2];
+        const char *old_pythonpath = getenv("PYTHONPATH");
+        if (old_pythonpath && old_pythonpath[0]) {
+            snprintf(pythonpath, sizeof(pythonpath), "%s/%s%s%s", executable_path, src_dir, IsWindows() ? ";" : ":", old_pythonpath);
+        } else {
+            snprintf(pythonpath, sizeof(pythonpath), "%s/%s", executable_path, src_dir);
+        }
+        set_env("PYTHONPATH", pythonpath);
+    }
+}
+
+// Open dst_path for writing without ever writing through an existing inode: it may be
+// a hardlink into the shared store, a library mapped by a running process or a file
+// another launcher is reading. A new file is created in place, a replacement is
+// written to a temporary sibling that publish_output() renames over the old file,
+// so readers see either the old or the new content and never a torn file.
+static int create_output(const char *dst_path, mode_t mode, char *tmp_path, size_t tmp_size) {
+    tmp_path[0] = '\0';
+    int fd = open(dst_path, O_WRONLY | O_CREAT | O_EXCL, mode);
+    if (fd != -1 || errno != EEXIST) return fd;
+    snprintf(tmp_path, tmp_size, "%s.pyfuze-tmp.%d.%lx", dst_path, (int)getpid(), (unsigned long)pthread_self());
+    return open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+}
+
+static void publish_output(const char *tmp_path, const char *dst_path) {
+    if (tmp_path[0] == '\0') return;
+    if (rename(tmp_path, dst_path) != 0) {
+        unlink(tmp_path);
+        exit_with_message("Failed to replace %s", dst_path);
+    }
+}
+
+// Entries are extracted straight from the executable through the zip index, without
+// a /zip filesystem lookup per file. Stored (uncompressed) entries sit at a fixed
+// offset and are copied with the kernel helpers, deflated and zstd ones are decompressed
+// from the mapping. Returns 0 if the entry can't be handled so the caller takes the
+// /zip path, which only knows stored and deflated entries.
+static int copy_zip_entry(const char *name, const char *dst_path) {
+    const ZipArchive *archive = open_self_zip();
+    const ZipEntry *entry = find_zip_entry(archive, name);
+    if (!entry || (entry->method != ZIP_METHOD_STORED && entry->method != ZIP_METHOD_DEFLATED && entry->method != ZIP_METHOD_ZSTD)) return 0;
+    int64_t offset = zip_entry_data_offset(archive, entry);
+    if (offset < 0) return 0;
+
+    char tmp_path[PATH_MAX];
+    int dst_fd = create_output(dst_path, entry->mode & 07777, tmp_path, sizeof(tmp_path));
+    if (dst_fd == -1) exit_with_message("Failed to create %s", dst_path);
+    int strategy = COPY_READ_WRITE;
+    int failed;
+    if (entry->method == ZIP_METHOD_STORED) {
+        strategy = copy_fd_range(archive->fd, offset, dst_fd, entry->size);
+        failed = strategy < 0;
+    } else {
+        failed = zip_decompress_entry(archive, entry, dst_fd) != 0;
+    }
+    close(dst_fd);
+
+    if (failed) {
+        unlink(tmp_path[0] ? tmp_path : dst_path);
+        exit_with_message("Failed to extract /zip/%s to %s", name, dst_path);
+    }
+    publish_output(tmp_path, dst_path);
+    trace_count_file(entry->size);
+    debug_log("copied /zip/%s to %s via %s\n", name, dst_path, entry->method == ZIP_METHOD_STORED ? copy_strategy_name(strategy) : entry->method == ZIP_METHOD_ZSTD ? "zstd" : "inflate");
+    return 1;
 }
 
 void copy_file(const char *src_path, const char *dst_path) {
     struct stat st;
     int src_fd, dst_fd;
 
+    int from_zip = strncmp(src_path, "/zip/", 5) == 0;
+    if (from_zip && copy_zip_entry(src_path + 5, dst_path)) return;
+
     if ((src_fd = open(src_path, O_RDONLY)) == -1) exit_with_message("Failed to open %s", src_path);
     fstat(src_fd, &st);
 
-    if ((dst_fd = creat(dst_path, st.st_mode)) == -1) {
+    char tmp_path[PATH_MAX];
+    if ((dst_fd = create_output(dst_path, st.st_mode, tmp_path, sizeof(tmp_path))) == -1) {
         close(src_fd);
         exit_with_message("Failed to create %s", dst_path);
     }
 
-    ssize_t result = copyfd(src_fd, dst_fd, -1);
+    // compressed /zip entries are inflated in user space, real files can use the kernel helpers
+    int strategy = from_zip ? COPY_READ_WRITE : copy_fd_range(src_fd, 0, dst_fd, st.st_size);
+    ssize_t result = from_zip ? copyfd(src_fd, dst_fd, -1) : strategy;
     close(src_fd);
     close(dst_fd);
 
     if (result == -1) exit_with_message("Failed to copy %s to %s", src_path, dst_path);
+    publish_output(tmp_path, dst_path);
+    trace_count_file((uint64_t)st.st_size);
+    debug_log("copied %s to %s via %s\n", src_path, dst_path, copy_strategy_name(strategy));
+}
+
+// Hardlink src_path to dst_path, replacing an existing file through a temporary link
+// and rename so the path never goes missing for a running reader.
+// Returns -1 with errno set if the link can't be created.
+int link_file(const char *src_path, const char *dst_path) {
+    if (link(src_path, dst_path) == 0) return 0;
+    if (errno != EEXIST) return -1;
+
+    // rename() between two links of one inode succeeds without doing anything
+    struct stat src_st, dst_st;
+    if (stat(src_path, &src_st) == 0 && stat(dst_path, &dst_st) == 0 &&
+        src_st.st_dev == dst_st.st_dev && src_st.st_ino == dst_st.st_ino) {
+        return 0;
+    }
+
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.pyfuze-tmp.%d.%lx", dst_path, (int)getpid(), (unsigned long)pthread_self());
+    if (link(src_path, tmp) != 0) return -1;
+    if (rename(tmp, dst_path) != 0) {
+        unlink(tmp);
+        exit_with_message("Failed to replace %s", dst_path);
+    }
+    return 0;
 }
 
 void mkdir_recursive(const char *path) {
@@ -243,40 +468,11 @@ void mkdir_recursive(const char *path) {
 }
 
 void copy_directory(const char *src_dir, const char *dst_dir) {
-    struct stat st;
-    if (stat(src_dir, &st) != 0) exit_with_message("stat %s failed", src_dir);
-
-    if (!path_exists(dst_dir)) {
-        mkdir_recursive(dst_dir);
-    }
-
-    DIR *dir = opendir(src_dir);
-    if (!dir) exit_with_message("opendir %s failed", src_dir);
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        char src_path[PATH_MAX];
-        char dst_path[PATH_MAX];
-        snprintf(src_path, sizeof(src_path), "%s/%s", src_dir, entry->d_name);
-        snprintf(dst_path, sizeof(dst_path), "%s/%s", dst_dir, entry->d_name);
-
-        if (stat(src_path, &st) != 0) {
-            closedir(dir);
-            exit_with_message("stat %s failed", src_path);
-        }
-
-        if (S_ISDIR(st.st_mode)) {
-            copy_directory(src_path, dst_path);
-        } else if (S_ISREG(st.st_mode)) {
-            copy_file(src_path, dst_path);
-        }
-    }
-
-    closedir(dir);
+    ExtractPlan plan;
+    init_extract_plan(&plan);
+    plan_add_directory(&plan, src_dir, dst_dir);
+    run_extract_plan(&plan, config_extract_threads);
+    free_extract_plan(&plan);
 }
 
 void set_env(const char *key, const char *value) {
@@ -294,13 +490,156 @@ void set_env(const char *key, const char *value) {
 void read_build_id(const char *path, char *build_id) {
     FILE *file = fopen(path, "r");
     if (!file) return;
-    fread(build_id, 1, MAX_BUILD_ID_LENGTH, file);
+    fread(build_id, 1, MAX_BUILD_ID_LENGTH - 1, file);
     fclose(file);
 }
 
-// Check if the build ID in the zip differs from the current one.
-// If changed, unzip and overwrite existing files.
-void unzip() {
+// Create the parent directory of path.
+// Manifest entries are sorted, so consecutive files usually share last_dir and skip the syscalls.
+static void ensure_parent_dir(const char *path, char *last_dir, size_t last_dir_size) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *last_slash = strrchr(dir, '/');
+    if (!last_slash) return;
+    *last_slash = '\0';
+    if (strcmp(dir, last_dir) == 0) return;
+    mkdir_recursive(dir);
+    snprintf(last_dir, last_dir_size, "%s", dir);
+}
+
+// Remove a file that is no longer in the manifest and prune the directories it leaves empty
+static void remove_stale_file(const char *path) {
+    if (unlink(path) != 0 && errno != ENOENT) exit_with_message("Failed to remove %s", path);
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *last_slash;
+    while ((last_slash = strrchr(dir, '/')) != NULL) {
+        *last_slash = '\0';
+        if (rmdir(dir) != 0) break;
+    }
+}
+
+// With src_in_zip the modules under src/ stay in the archive and are imported through
+// zipimport, only the entry script and data files are extracted.
+int imported_from_zip(const char *path) {
+    if (!config_src_in_zip || strncmp(path, "src/", 4) != 0) return 0;
+    if (strcmp(path + 4, config_entry) == 0) return 0;
+    size_t len = strlen(path);
+    return (len > 3 && strcmp(path + len - 3, ".py") == 0) || (len > 4 && strcmp(path + len - 4, ".pyc") == 0);
+}
+
+// Queue one manifest entry, through the shared store if use_store is set and it is
+// enabled. A deduplicated entry has no archive entry of its own and is hardlinked to
+// its extracted source instead, through the store both are links to one object anyway.
+void plan_manifest_entry(ExtractPlan *plan, const ManifestEntry *entry, int use_store) {
+    use_store = use_store && entry->hash && store_enabled();
+    if (entry->source && !use_store) {
+        plan_add_link(plan, entry->source, entry->path);
+        return;
+    }
+    char src_path[PATH_MAX];
+    path_join(src_path, sizeof(src_path), "/zip", entry->source ? entry->source : entry->path);
+    plan_add_object(plan, src_path, entry->path, use_store ? entry->hash : NULL, entry->mode);
+}
+
+// Queue only the entries that were added or changed since the previously extracted
+// manifest and remove the ones that were dropped. Without an existing manifest every
+// entry is extracted and overwritten.
+// Entries the journal lists were already put in place by an interrupted attempt.
+static void plan_manifest_delta(ExtractPlan *plan, const Manifest *manifest, const Manifest *existing, const ExtractJournal *journal) {
+    char last_dir[PATH_MAX] = {0};
+    size_t unchanged = 0;
+    size_t removed = 0;
+    size_t in_zip = 0;
+    size_t resumed = 0;
+
+    for (size_t i = 0; i < manifest->count; i++) {
+        const ManifestEntry *entry = &manifest->entries[i];
+        const ManifestEntry *old_entry = find_manifest_entry(existing, entry->path);
+        if (imported_from_zip(entry->path)) {
+            // an extracted copy would shadow the archive on sys.path
+            if (old_entry && path_exists(entry->path)) remove_stale_file(entry->path);
+            in_zip++;
+            continue;
+        }
+        if (old_entry && manifest_entry_equal(entry, old_entry) && path_exists(entry->path)) {
+            unchanged++;
+            continue;
+        }
+        if (journal_contains(journal, entry->path) && path_exists(entry->path)) {
+            resumed++;
+            continue;
+        }
+        ensure_parent_dir(entry->path, last_dir, sizeof(last_dir));
+        plan_manifest_entry(plan, entry, 1);
+    }
+
+    if (existing) {
+        for (size_t i = 0; i < existing->count; i++) {
+            if (find_manifest_entry(manifest, existing->entries[i].path)) continue;
+            remove_stale_file(existing->entries[i].path);
+            removed++;
+        }
+    }
+
+    console_log("%zu files to extract, %zu unchanged, %zu resumed, %zu removed, %zu imported from the executable\n", plan->count, unchanged, resumed, removed, in_zip);
+}
+
+// Launcher files in the archive root that are read from /zip and never extracted
+static int launcher_only_entry(const char *name) {
+    return strcmp(name, ".cosmo") == 0 ||
+           strcmp(name, config_name) == 0 ||
+           strcmp(name, binary_config_name) == 0 ||
+           strcmp(name, build_id_name) == 0 ||
+           strcmp(name, manifest_name) == 0 ||
+           strcmp(name, relocate_name) == 0 ||
+           strcmp(name, readahead_name) == 0;
+}
+
+// plan_top_level_entries() over the zip index. Entries are sorted by name, so the
+// entries under one top-level name are consecutive.
+static void plan_indexed_entries(ExtractPlan *plan, const ZipArchive *archive, int build_id_changed) {
+    char top[PATH_MAX] = {0};
+    char path[PATH_MAX];
+    char src_path[PATH_MAX];
+    char last_dir[PATH_MAX] = {0};
+    int skip = 1;
+
+    for (size_t i = 0; i < archive->count; i++) {
+        const char *name = archive->entries[i].name;
+        size_t top_length = strcspn(name, "/");
+        if (top_length == 0) continue;
+        if (strlen(top) != top_length || strncmp(top, name, top_length) != 0) {
+            snprintf(top, sizeof(top), "%.*s", (int)top_length, name);
+            skip = launcher_only_entry(top) || (!build_id_changed && path_exists(top));
+            if (!skip) console_log("found %s /zip/%s, extracting ...\n", name[top_length] ? "directory" : "file", top);
+        }
+        if (skip) continue;
+
+        snprintf(path, sizeof(path), "%s", name);
+        size_t length = strlen(path);
+        if (path[length - 1] == '/') {
+            path[length - 1] = '\0';
+            mkdir_recursive(path);
+            continue;
+        }
+        ensure_parent_dir(path, last_dir, sizeof(last_dir));
+        path_join(src_path, sizeof(src_path), "/zip", path);
+        plan_add_file(plan, src_path, path);
+    }
+}
+
+// Extract the top-level entries of /zip, skipping the ones that already exist
+// unless the build changed. Walks the /zip filesystem only if the zip index of
+// the executable can't be read.
+static void plan_top_level_entries(ExtractPlan *plan, int build_id_changed) {
+    const ZipArchive *archive = open_self_zip();
+    if (archive) {
+        plan_indexed_entries(plan, archive, build_id_changed);
+        return;
+    }
+
     char src_path[PATH_MAX] = {0};
     struct stat st;
 
@@ -308,21 +647,10 @@ void unzip() {
     struct dirent *ent;
     if (!d) exit_with_message("opendir /zip failed");
 
-    char build_id[MAX_BUILD_ID_LENGTH] = {0};
-    char existing_build_id[MAX_BUILD_ID_LENGTH] = {0};
-    read_build_id(zip_build_id_path, build_id);
-    read_build_id(build_id_name, existing_build_id);
-    int build_id_changed = strcmp(build_id, existing_build_id) != 0;
-    if (build_id_changed) {
-        console_log("build id changed, extracting and overwriting files...\n");
-    }
-
     while (ent = readdir(d)) {
         if (strcmp(ent->d_name, ".") == 0) continue;
         if (strcmp(ent->d_name, "..") == 0) continue;
-        if (strcmp(ent->d_name, ".cosmo") == 0) continue;
-        if (strcmp(ent->d_name, config_name) == 0) continue;
-        if (strcmp(ent->d_name, build_id_name) == 0) continue;
+        if (launcher_only_entry(ent->d_name)) continue;
 
         if (!build_id_changed && path_exists(ent->d_name)) continue;
 
@@ -334,19 +662,120 @@ void unzip() {
 
         if (S_ISDIR(st.st_mode)) {
             console_log("found directory %s, extracting ...\n", src_path);
-            copy_directory(src_path, ent->d_name);
+            plan_add_directory(plan, src_path, ent->d_name);
         } else if (S_ISREG(st.st_mode)) {
             console_log("found file %s, extracting ...\n", src_path);
-            copy_file(src_path, ent->d_name);
+            plan_add_file(plan, src_path, ent->d_name);
+        }
+    }
+
+    closedir(d);
+}
+
+// Serialize setup of unzip_path across launchers. Concurrent cold starts on a fresh
+// host queue here: the first one extracts and syncs, the others find everything in
+// place once they get the lock and only run the (cheap) checks again.
+// Waits at most PYFUZE_LOCK_TIMEOUT seconds.
+void lock_setup() {
+    setup_lock_fd = open(setup_lock_name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (setup_lock_fd == -1) exit_with_message("Failed to open %s", setup_lock_name);
+    if (flock(setup_lock_fd, LOCK_EX | LOCK_NB) == 0) return;
+
+    const char *timeout_env = getenv("PYFUZE_LOCK_TIMEOUT");
+    int timeout = timeout_env && timeout_env[0] ? atoi(timeout_env) : DEFAULT_LOCK_TIMEOUT_SECONDS;
+    console_log("waiting for another launcher to finish setting up %s...\n", config_unzip_path);
+
+    struct timespec begin, now;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    useconds_t backoff = 1000;
+    while (flock(setup_lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR) exit_with_message("Failed to lock %s", setup_lock_name);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - begin.tv_sec >= timeout) {
+            exit_with_message("ERROR: timed out after %d seconds waiting for %s/%s", timeout, config_unzip_path, setup_lock_name);
         }
+        usleep(backoff);
+        if (backoff < 100000) backoff *= 2;
+    }
+}
+
+void unlock_setup() {
+    if (setup_lock_fd == -1) return;
+    flock(setup_lock_fd, LOCK_UN);
+    close(setup_lock_fd);
+    setup_lock_fd = -1;
+}
+
+// The file index of the bundle: the binary launch manifest, or the text manifest
+// of bundles built before it existed. NULL for bundles without either.
+Manifest *load_bundle_manifest() {
+    Manifest *manifest = manifest_from_config(launch_config);
+    return manifest ? manifest : parse_manifest(zip_manifest_path);
+}
+
+// Check if the build ID in the zip differs from the current one.
+// If changed, diff the bundled manifest against the one stored in unzip_path and
+// only write what changed, journaling progress so an interrupted extraction resumes.
+// If not, verify the extracted files and repair the ones that went missing or were
+// damaged (PYFUZE_VERIFY). Bundles without a manifest fall back to overwriting
+// every top-level entry. All file copies are fanned out to the worker pool.
+// Returns 1 if the extracted tree changed.
+int unzip() {
+    char build_id[MAX_BUILD_ID_LENGTH] = {0};
+    char existing_build_id[MAX_BUILD_ID_LENGTH] = {0};
+    read_build_id(zip_build_id_path, build_id);
+    read_build_id(build_id_name, existing_build_id);
+    int build_id_changed = strcmp(build_id, existing_build_id) != 0;
+    if (build_id_changed) {
+        console_log("build id changed, extracting and overwriting files...\n");
+    }
+
+    uint64_t start = TRACE_START();
+    ExtractPlan plan;
+    init_extract_plan(&plan);
+    ExtractJournal journal = {0};
+    journal.fd = -1;
+    int changed = build_id_changed;
+
+    int mode = verify_mode();
+    Manifest *manifest = NULL;
+    if (build_id_changed || mode != VERIFY_OFF) manifest = load_bundle_manifest();
+    if (manifest && build_id_changed) {
+        if (config_shared_store) init_store();
+        Manifest *existing = parse_manifest(manifest_name);
+        open_extract_journal(&journal, build_id);
+        plan.journal_fd = journal.fd;
+        plan_manifest_delta(&plan, manifest, existing, &journal);
+        free_manifest(existing);
+    } else if (manifest) {
+        changed = verify_extracted_files(manifest, &plan, mode);
+    } else {
+        plan_top_level_entries(&plan, build_id_changed);
+        changed = changed || plan.count > 0;
     }
+    TRACE_PHASE("plan extraction", start);
+
+    start = TRACE_START();
+    run_extract_plan(&plan, config_extract_threads);
+    free_extract_plan(&plan);
+    TRACE_PHASE("extract files", start);
+
+    if (manifest && build_id_changed) {
+        // an upgrade may have dropped the last links to some shared objects
+        store_gc();
+
+        // the manifest is only stored once every entry it lists is in place,
+        // an interrupted update is diffed against the previous one again
+        copy_file(zip_manifest_path, manifest_name);
+    }
+    free_manifest(manifest);
 
     if (build_id_changed) {
         copy_file(zip_build_id_path, build_id_name);
+        finish_extract_journal(&journal);
         console_log("successfully updated %s\n", build_id_name);
     }
-
-    closedir(d);
+    return changed;
 }
 
 int run_command_windows_utf16(char16_t *cmd, int no_stdin) {
@@ -397,27 +826,27 @@ int run_command_windows_utf16(char16_t *cmd, int no_stdin) {
 }
 
 int run_command_windows(char *cmd) {
+    uint64_t start = TRACE_START();
     char16_t *cmdline_utf16 = utf8to16(cmd, -1, 0);
     int ret = run_command_windows_utf16(cmdline_utf16, 1);
     free(cmdline_utf16);
+    trace_command((const char *const[]){cmd, NULL}, start, ret);
     return ret;
 }
 
 int run_command_windows_normal(char *cmd) {
+    uint64_t start = TRACE_START();
     char16_t *cmdline_utf16 = utf8to16(cmd, -1, 0);
     int ret = run_command_windows_utf16(cmdline_utf16, 0);
     free(cmdline_utf16);
+    trace_command((const char *const[]){cmd, NULL}, start, ret);
     return ret;
 }
 
-int run_command_unix(const char *const argv[]) {
-    pid_t pid;
+static int wait_exit_code(pid_t pid, const char *program) {
     int status;
-    if (posix_spawnp(&pid, argv[0], NULL, NULL, (char *const *)argv, environ) != 0) {
-        exit_with_message("posix_spawnp at %s failed", argv[0]);
-    }
     if (waitpid(pid, &status, 0) == -1) {
-        exit_with_message("waitpid at %s failed", argv[0]);
+        exit_with_message("waitpid at %s failed", program);
     }
     if (WIFEXITED(status)) {
         return WEXITSTATUS(status);
@@ -428,55 +857,85 @@ int run_command_unix(const char *const argv[]) {
     return 1;
 }
 
+int run_command_unix(const char *const argv[]) {
+    pid_t pid;
+    uint64_t start = TRACE_START();
+    if (posix_spawnp(&pid, argv[0], NULL, NULL, (char *const *)argv, environ) != 0) {
+        exit_with_message("posix_spawnp at %s failed", argv[0]);
+    }
+    int ret = wait_exit_code(pid, argv[0]);
+    trace_command(argv, start, ret);
+    return ret;
+}
+
 #define RUN_COMMAND_UNIX(...) \
     run_command_unix((const char *const[]){__VA_ARGS__, NULL})
 
-void install_uv() {
+int install_uv() {
+    char cmdline[MAX_CMDLINE];
     if (IsWindows()) {
         if (path_exists(config_uv_install_script_windows)) {
             snprintf(cmdline, sizeof(cmdline), "\"C:\\Windows\\System32\\WindowsPowerShell\\v1.0\\powershell.exe\" -NoProfile -ExecutionPolicy Bypass -File \"%s\"", config_uv_install_script_windows);
         } else {
             snprintf(cmdline, sizeof(cmdline), "\"C:\\Windows\\System32\\WindowsPowerShell\\v1.0\\powershell.exe\" -NoProfile -ExecutionPolicy Bypass -c \"irm %s | iex\"", config_uv_install_script_windows);
         }
-        run_command_windows(cmdline);
+        return run_command_windows(cmdline);
     } else {
         if (path_exists(config_uv_install_script_unix)) {
-            RUN_COMMAND_UNIX("sh", config_uv_install_script_unix);
+            return RUN_COMMAND_UNIX("sh", config_uv_install_script_unix);
         } else {
             snprintf(cmdline, sizeof(cmdline), "curl -LsSf %s | sh", config_uv_install_script_unix);
-            RUN_COMMAND_UNIX("sh", "-c", cmdline);
+            return RUN_COMMAND_UNIX("sh", "-c", cmdline);
         }
     }
 }
 
-void install_python() {
+// version may be empty, uv then picks it from the project files in unzip_path
+int install_python(const char *version) {
+    char cmdline[MAX_CMDLINE];
     if (IsWindows()) {
-        snprintf(cmdline, sizeof(cmdline), "\"%s\" python install --install-dir %s", uv_path, python_dir);
-        run_command_windows(cmdline);
+        snprintf(cmdline, sizeof(cmdline), "\"%s\" python install %s --install-dir %s", uv_path, version, python_dir);
+        return run_command_windows(cmdline);
+    } else if (version[0]) {
+        return RUN_COMMAND_UNIX(uv_path, "python", "install", version, "--install-dir", python_dir);
     } else {
-        RUN_COMMAND_UNIX(uv_path, "python", "install", "--install-dir", python_dir);
+        return RUN_COMMAND_UNIX(uv_path, "python", "install", "--install-dir", python_dir);
     }
 }
 
-void uv_init() {
+int uv_init() {
+    char cmdline[MAX_CMDLINE];
     if (IsWindows()) {
         snprintf(cmdline, sizeof(cmdline), "\"%s\" init --bare --no-workspace", uv_path);
-        run_command_windows(cmdline);
+        return run_command_windows(cmdline);
     } else {
-        RUN_COMMAND_UNIX(uv_path, "init", "--bare", "--no-workspace");
+        return RUN_COMMAND_UNIX(uv_path, "init", "--bare", "--no-workspace");
     }
 }
 
-void uv_add_dependencies() {
+int uv_add_dependencies() {
+    char cmdline[MAX_CMDLINE];
     if (IsWindows()) {
         snprintf(cmdline, sizeof(cmdline), "\"%s\" add -r %s --python %s", uv_path, requirements_txt_path, python_path);
+        return run_command_windows(cmdline);
+    } else {
+        return RUN_COMMAND_UNIX(uv_path, "add", "-r", requirements_txt_path, "--python", python_path);
+    }
+}
+
+// Drop cache entries the synced venv doesn't reference anymore
+void uv_cache_prune() {
+    char cmdline[MAX_CMDLINE];
+    if (IsWindows()) {
+        snprintf(cmdline, sizeof(cmdline), "\"%s\" cache prune --quiet", uv_path);
         run_command_windows(cmdline);
     } else {
-        RUN_COMMAND_UNIX(uv_path, "add", "-r", requirements_txt_path, "--python", python_path);
+        RUN_COMMAND_UNIX(uv_path, "cache", "prune", "--quiet");
     }
 }
 
-void uv_sync(int frozen, int python) {
+int uv_sync(int frozen, int python) {
+    char cmdline[MAX_CMDLINE];
     if (IsWindows()) {
         snprintf(cmdline, sizeof(cmdline), "\"%s\" sync --quiet", uv_path);
         if (frozen) {
@@ -486,26 +945,92 @@ void uv_sync(int frozen, int python) {
             strcat(cmdline, " --python ");
             strcat(cmdline, python_path);
         }
-        run_command_windows(cmdline);
+        return run_command_windows(cmdline);
     } else {
         if (frozen) {
             if (python) {
-                RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--frozen", "--python", python_path);
+                return RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--frozen", "--python", python_path);
             } else {
-                RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--frozen");
+                return RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--frozen");
             }
         } else {
             if (python) {
-                RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--python", python_path);
+                return RUN_COMMAND_UNIX(uv_path, "sync", "--quiet", "--python", python_path);
             } else {
-                RUN_COMMAND_UNIX(uv_path, "sync", "--quiet");
+                return RUN_COMMAND_UNIX(uv_path, "sync", "--quiet");
             }
         }
     }
 }
 
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a_update(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Mix the path and the file contents (or a missing marker) into hash
+static uint64_t fnv1a_file(uint64_t hash, const char *path) {
+    hash = fnv1a_update(hash, path, strlen(path) + 1);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return fnv1a_update(hash, "\xff", 1);
+
+    char buf[16384];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        hash = fnv1a_update(hash, buf, (size_t)n);
+    }
+    close(fd);
+    return hash;
+}
+
+// Everything uv sync depends on: project files, build id, interpreter and the venv it made
+static void compute_sync_fingerprint(char *fingerprint, size_t fingerprint_size) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = fnv1a_file(hash, uv_lock_path);
+    hash = fnv1a_file(hash, pyproject_toml_path);
+    hash = fnv1a_file(hash, requirements_txt_path);
+    hash = fnv1a_file(hash, build_id_name);
+    hash = fnv1a_file(hash, pyvenv_cfg_path);
+    hash = fnv1a_update(hash, python_path, strlen(python_path) + 1);
+    snprintf(fingerprint, fingerprint_size, "%016llx", (unsigned long long)hash);
+}
+
+int sync_fingerprint_matches() {
+    const char *force_sync = getenv("PYFUZE_FORCE_SYNC");
+    if (force_sync && force_sync[0] && strcmp(force_sync, "0") != 0) return 0;
+
+    char fingerprint[SYNC_FINGERPRINT_LENGTH] = {0};
+    char existing_fingerprint[SYNC_FINGERPRINT_LENGTH] = {0};
+    compute_sync_fingerprint(fingerprint, sizeof(fingerprint));
+
+    FILE *file = fopen(sync_stamp_name, "r");
+    if (!file) return 0;
+    fread(existing_fingerprint, 1, sizeof(existing_fingerprint) - 1, file);
+    fclose(file);
+    return strcmp(fingerprint, existing_fingerprint) == 0;
+}
+
+// Record the state after a successful uv sync so the next launch can skip it
+void write_sync_fingerprint() {
+    char fingerprint[SYNC_FINGERPRINT_LENGTH] = {0};
+    compute_sync_fingerprint(fingerprint, sizeof(fingerprint));
+
+    FILE *file = fopen(sync_stamp_name, "w");
+    if (!file) return;
+    fputs(fingerprint, file);
+    fclose(file);
+}
+
 int uv_run(int gui, int argc, char *argv[]) {
     if (IsWindows()) {
+        char cmdline[MAX_CMDLINE];
         if (gui) {
             snprintf(cmdline, sizeof(cmdline), "\"%s\" run --project %s --directory %s --gui-script %s", uv_path, config_unzip_path, src_dir, config_entry);
         } else {
@@ -538,3 +1063,72 @@ int uv_run(int gui, int argc, char *argv[]) {
         return run_command_unix(args);
     }
 }
+
+// Point VIRTUAL_ENV and PATH at the project's venv the way uv run would and store
+// the path of its interpreter in venv_python. Returns 0 if the venv is not usable.
+int prepare_venv_env(char *venv_python, size_t venv_python_size) {
+    char cwd[PATH_MAX] = {0};
+    char venv_dir[PATH_MAX] = {0};
+    char venv_bin[PATH_MAX] = {0};
+    char new_path[MAX_CMDLINE];
+    if (!getcwd(cwd, sizeof(cwd))) return 0;
+    path_join(venv_dir, sizeof(venv_dir), cwd, venv_path);
+    path_join(venv_bin, sizeof(venv_bin), venv_dir, "bin");
+    path_join(venv_python, venv_python_size, venv_bin, "python");
+
+    if (!path_exists(pyvenv_cfg_path) || access(venv_python, X_OK) != 0 || !path_exists(src_dir)) {
+        return 0;
+    }
+
+    // already done by an earlier attempt (zygote, then direct exec)
+    const char *virtual_env = getenv("VIRTUAL_ENV");
+    if (virtual_env && strcmp(virtual_env, venv_dir) == 0) return 1;
+
+    set_env("VIRTUAL_ENV", venv_dir);
+    const char *old_path = getenv("PATH");
+    if (old_path && old_path[0]) {
+        snprintf(new_path, sizeof(new_path), "%s:%s", venv_bin, old_path);
+        set_env("PATH", new_path);
+    } else {
+        set_env("PATH", venv_bin);
+    }
+    unsetenv("PYTHONHOME");
+    return 1;
+}
+
+// Replace the launcher with the venv interpreter running the entry, set up the way
+// uv run would. Returns only if the venv is not usable so the caller can fall back.
+void exec_venv_python(int argc, char *argv[]) {
+    if (IsWindows()) return;
+
+    uint64_t start = TRACE_START();
+    char cwd[PATH_MAX] = {0};
+    char venv_python[PATH_MAX] = {0};
+    if (!getcwd(cwd, sizeof(cwd))) return;
+    if (!prepare_venv_env(venv_python, sizeof(venv_python))) {
+        console_log("%s is not usable, falling back to uv run\n", venv_python);
+        return;
+    }
+
+    if (chdir(src_dir) != 0) return;
+
+    const char **args = calloc(argc + 2, sizeof(char *));
+    int idx = 0;
+    args[idx++] = venv_python;
+    args[idx++] = config_entry;
+    for (int i = 1; i < argc; ++i) {
+        args[idx++] = argv[i];
+    }
+    args[idx] = NULL;
+
+    // checking the venv and setting up its environment, the exec itself isn't timed
+    TRACE_PHASE("exec python", start);
+    trace_flush();
+    fflush(stdout);
+    fflush(stderr);
+    execve(venv_python, (char *const *)args, environ);
+
+    console_log("execve %s failed, falling back to uv run\n", venv_python);
+    free(args);
+    chdir(cwd);
+}
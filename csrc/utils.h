@@ -1,11 +1,17 @@
 #pragma once
 
 #include "config.h"
+#include "extract.h"
 #include "limits.h"
+#include "manifest.h"
+
+#define MAX_BUILD_ID_LENGTH 128
 
 extern int attach_console;
 extern int alloc_console;
 
+extern const char *build_id_name;
+
 extern const char *uv_dir;
 extern const char *cache_dir;
 extern const char *dot_python_version_path;
@@ -16,6 +22,7 @@ extern const char *src_dir;
 extern const char *pyproject_toml_path;
 extern const char *requirements_txt_path;
 extern const char *uv_lock_path;
+extern const char *pycache_dir;
 
 extern char uv_path[PATH_MAX];
 extern char python_path[PATH_MAX];
@@ -25,21 +32,46 @@ extern char config_uv_install_script_windows[PATH_MAX];
 extern char config_uv_install_script_unix[PATH_MAX];
 extern char config_entry[PATH_MAX];
 extern int config_win_gui;
+extern int config_extract_threads;
+extern int config_direct_exec;
+extern int config_shared_store;
+extern int config_src_in_zip;
+extern int config_versioned;
+extern int config_compile_bytecode;
+extern int config_optimize;
+extern int config_zygote;
+extern int config_zygote_idle_timeout;
+extern char config_zygote_preload[PATH_MAX];
 
 void exit_with_message(const char *format, ...);
 void console_log(const char *format, ...);
+void debug_log(const char *format, ...);
 void close_console();
 int path_exists(const char *filename);
+void path_join(char *result, size_t result_size, const char *p1, const char *p2);
 void find_python_path();
+void convert_to_windows_path(char *path);
 void init();
 void copy_file(const char *src_path, const char *dst_path);
+int link_file(const char *src_path, const char *dst_path);
 void mkdir_recursive(const char *path);
 void copy_directory(const char *src_dir, const char *dst_dir);
 void set_env(const char *key, const char *value);
-void unzip();
-void install_uv();
-void install_python();
-void uv_init();
-void uv_add_dependencies();
-void uv_sync(int frozen, int python);
+void read_build_id(const char *path, char *build_id);
+void lock_setup();
+void unlock_setup();
+int imported_from_zip(const char *path);
+void plan_manifest_entry(ExtractPlan *plan, const ManifestEntry *entry, int use_store);
+Manifest *load_bundle_manifest();
+int unzip();
+int install_uv();
+int install_python(const char *version);
+int uv_init();
+int uv_add_dependencies();
+void uv_cache_prune();
+int uv_sync(int frozen, int python);
+int sync_fingerprint_matches();
+void write_sync_fingerprint();
 int uv_run(int gui, int argc, char *argv[]);
+int prepare_venv_env(char *venv_python, size_t venv_python_size);
+void exec_venv_python(int argc, char *argv[]);
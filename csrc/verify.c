@@ -0,0 +1,369 @@
+#include "verify.h"
+
+#include "fcntl.h"
+#include "libc/errno.h"
+#include "limits.h"
+#include "pthread.h"
+#include "relocate.h"
+#include "stdatomic.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "third_party/zlib/zlib.h"
+#include "trace.h"
+#include "unistd.h"
+#include "utils.h"
+
+#define MAX_VERIFY_THREADS 64
+#define VERIFY_BATCH 64
+#define HASH_BUFFER_SIZE (256 * 1024)
+
+#define FILE_OK 0
+#define FILE_SKIPPED 1
+#define FILE_CHANGED 2
+#define FILE_DAMAGED 3
+
+// The extracted tree as the last setup left it, one line per manifest entry:
+// "<size>\t<mtime seconds>\t<mtime nanoseconds>\t<path>"
+const char *extract_index_name = ".pyfuze_index.txt";
+// The build id being extracted, followed by every path already in place for it
+const char *extract_journal_name = ".pyfuze_journal.txt";
+
+typedef struct {
+    const char *path;
+    uint64_t size;
+    int64_t mtime_sec;
+    long mtime_nsec;
+} IndexEntry;
+
+typedef struct {
+    char *data;
+    IndexEntry *entries;
+    size_t count;
+} ExtractIndex;
+
+typedef struct {
+    const Manifest *manifest;
+    const ExtractIndex *index;
+    unsigned char *status;
+    int mode;
+} VerifyPass;
+
+typedef struct {
+    void (*fn)(void *ctx, size_t i);
+    void *ctx;
+    size_t count;
+    _Atomic size_t next;
+} ParallelLoop;
+
+// Read a whole file into one NUL-terminated buffer
+static char *read_text_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    struct stat st;
+    char *data = NULL;
+    if (fstat(fd, &st) == 0 && (data = malloc((size_t)st.st_size + 1))) {
+        size_t size = 0;
+        ssize_t n;
+        while (size < (size_t)st.st_size && (n = read(fd, data + size, (size_t)st.st_size - size)) > 0) {
+            size += (size_t)n;
+        }
+        data[size] = '\0';
+    }
+    close(fd);
+    return data;
+}
+
+static size_t count_lines(const char *data) {
+    size_t count = 0;
+    for (const char *p = data; *p; p++) {
+        if (*p == '\n') count++;
+    }
+    return count;
+}
+
+static int compare_index_entries(const void *a, const void *b) {
+    return strcmp(((const IndexEntry *)a)->path, ((const IndexEntry *)b)->path);
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Returns 0 if there is no index yet
+static int load_extract_index(ExtractIndex *index) {
+    index->entries = NULL;
+    index->count = 0;
+    index->data = read_text_file(extract_index_name);
+    if (!index->data) return 0;
+    index->entries = malloc(sizeof(IndexEntry) * (count_lines(index->data) + 1));
+    if (!index->entries) exit_with_message("Out of memory reading %s", extract_index_name);
+
+    int sorted = 1;
+    char *line = index->data;
+    char *next;
+    for (; (next = strchr(line, '\n')) != NULL; line = next + 1) {
+        *next = '\0';
+        char *end;
+        IndexEntry entry;
+        entry.size = strtoull(line, &end, 10);
+        if (*end != '\t') continue;
+        entry.mtime_sec = strtoll(end + 1, &end, 10);
+        if (*end != '\t') continue;
+        entry.mtime_nsec = strtol(end + 1, &end, 10);
+        if (*end != '\t' || end[1] == '\0') continue;
+        entry.path = end + 1;
+        if (index->count > 0 && strcmp(index->entries[index->count - 1].path, entry.path) > 0) sorted = 0;
+        index->entries[index->count++] = entry;
+    }
+    if (!sorted) qsort(index->entries, index->count, sizeof(IndexEntry), compare_index_entries);
+    return 1;
+}
+
+static const IndexEntry *find_index_entry(const ExtractIndex *index, const char *path) {
+    IndexEntry key;
+    key.path = path;
+    return bsearch(&key, index->entries, index->count, sizeof(IndexEntry), compare_index_entries);
+}
+
+static void *parallel_worker(void *arg) {
+    ParallelLoop *loop = arg;
+    for (;;) {
+        size_t begin = atomic_fetch_add(&loop->next, VERIFY_BATCH);
+        if (begin >= loop->count) return NULL;
+        size_t end = begin + VERIFY_BATCH < loop->count ? begin + VERIFY_BATCH : loop->count;
+        for (size_t i = begin; i < end; i++) loop->fn(loop->ctx, i);
+    }
+}
+
+// Run fn over [0, count) in batches on up to config_extract_threads threads
+static void parallel_for(size_t count, void (*fn)(void *ctx, size_t i), void *ctx) {
+    ParallelLoop loop;
+    loop.fn = fn;
+    loop.ctx = ctx;
+    loop.count = count;
+    atomic_init(&loop.next, 0);
+
+    long num_threads = config_extract_threads;
+    if (num_threads <= 0) num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > MAX_VERIFY_THREADS) num_threads = MAX_VERIFY_THREADS;
+    long batches = (long)((count + VERIFY_BATCH - 1) / VERIFY_BATCH);
+    if (num_threads > batches) num_threads = batches;
+
+    pthread_t threads[MAX_VERIFY_THREADS];
+    int started = 0;
+    for (long i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, parallel_worker, &loop) != 0) break;
+        started++;
+    }
+    parallel_worker(&loop);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+}
+
+// CRC-32 of a file, the checksum the manifest carries from the zip entries.
+// zlib's implementation uses the carry-less multiply instructions where available.
+static int file_crc32(const char *path, uint64_t *size, uint32_t *crc) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+    unsigned char *buffer = malloc(HASH_BUFFER_SIZE);
+    if (!buffer) exit_with_message("Out of memory verifying %s", path);
+
+    uLong value = crc32(0L, Z_NULL, 0);
+    uint64_t total = 0;
+    ssize_t n;
+    while ((n = read(fd, buffer, HASH_BUFFER_SIZE)) > 0) {
+        value = crc32(value, buffer, (uInt)n);
+        total += (uint64_t)n;
+    }
+    free(buffer);
+    close(fd);
+    *size = total;
+    *crc = (uint32_t)value;
+    return n < 0 ? -1 : 0;
+}
+
+// Compare size and mtime against the index, or the size against the manifest
+// when there is no index yet
+static void stat_entry(void *ctx, size_t i) {
+    VerifyPass *pass = ctx;
+    const ManifestEntry *entry = &pass->manifest->entries[i];
+    if (imported_from_zip(entry->path)) {
+        pass->status[i] = FILE_SKIPPED;
+        return;
+    }
+
+    struct stat st;
+    if (stat(entry->path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        pass->status[i] = FILE_DAMAGED;
+        return;
+    }
+    const IndexEntry *known = pass->index->data ? find_index_entry(pass->index, entry->path) : NULL;
+    int same;
+    if (known) {
+        same = (uint64_t)st.st_size == known->size && (int64_t)st.st_mtim.tv_sec == known->mtime_sec && st.st_mtim.tv_nsec == known->mtime_nsec;
+    } else {
+        same = (uint64_t)st.st_size == entry->size;
+    }
+    pass->status[i] = same ? FILE_OK : FILE_CHANGED;
+}
+
+static void hash_entry(void *ctx, size_t i) {
+    VerifyPass *pass = ctx;
+    unsigned char status = pass->status[i];
+    if (status != FILE_CHANGED && !(status == FILE_OK && pass->mode == VERIFY_FULL)) return;
+
+    const ManifestEntry *entry = &pass->manifest->entries[i];
+    uint64_t size;
+    uint32_t crc;
+    if (file_crc32(entry->path, &size, &crc) != 0 || size != entry->size || crc != entry->crc32) {
+        pass->status[i] = FILE_DAMAGED;
+    }
+}
+
+// PYFUZE_VERIFY=0 skips verification, PYFUZE_VERIFY=full hashes every file
+int verify_mode() {
+    const char *mode = getenv("PYFUZE_VERIFY");
+    if (!mode || !mode[0]) return VERIFY_STAT;
+    if (strcmp(mode, "0") == 0 || strcmp(mode, "off") == 0) return VERIFY_OFF;
+    if (strcmp(mode, "full") == 0) return VERIFY_FULL;
+    return VERIFY_STAT;
+}
+
+// Check the extracted tree of an unchanged build against the manifest and queue the
+// files that are missing or damaged to be extracted again. Only files whose size or
+// mtime moved since the last setup are hashed, unless mode is VERIFY_FULL.
+// Returns 1 if the index no longer matches the tree and should be saved again.
+int verify_extracted_files(const Manifest *manifest, ExtractPlan *plan, int mode) {
+    ExtractIndex index;
+    int has_index = load_extract_index(&index);
+    VerifyPass pass;
+    pass.manifest = manifest;
+    pass.index = &index;
+    pass.mode = mode;
+    pass.status = malloc(manifest->count + 1);
+    if (!pass.status) exit_with_message("Out of memory verifying %s", config_unzip_path);
+
+    uint64_t start = TRACE_START();
+    parallel_for(manifest->count, stat_entry, &pass);
+    TRACE_PHASE("verify stat", start);
+
+    start = TRACE_START();
+    parallel_for(manifest->count, hash_entry, &pass);
+    TRACE_PHASE("verify hash", start);
+
+    size_t changed = 0;
+    size_t damaged = 0;
+    char dir[PATH_MAX];
+    for (size_t i = 0; i < manifest->count; i++) {
+        const char *path = manifest->entries[i].path;
+        if (pass.status[i] == FILE_CHANGED) changed++;
+        if (pass.status[i] != FILE_DAMAGED) continue;
+        damaged++;
+
+        snprintf(dir, sizeof(dir), "%s", path);
+        char *last_slash = strrchr(dir, '/');
+        if (last_slash) {
+            *last_slash = '\0';
+            if (!path_exists(dir)) mkdir_recursive(dir);
+        }
+        // a damaged store object would be linked again, copy from the archive
+        plan_manifest_entry(plan, &manifest->entries[i], 0);
+        // a fresh copy carries the build paths again
+        if (strncmp(path, ".venv/", 6) == 0) invalidate_relocation();
+    }
+    free(pass.status);
+    free(index.entries);
+    free(index.data);
+
+    if (damaged) {
+        console_log("%zu files missing or damaged in %s, extracting them again...\n", damaged, config_unzip_path);
+    }
+    debug_log("verified %zu files: %zu changed on disk, %zu damaged\n", manifest->count, changed, damaged);
+    return !has_index || changed > 0 || damaged > 0;
+}
+
+// Record size and mtime of every extracted file for the next launch's stat pass.
+// Called once setup is done changing the tree, after relocation and uv sync.
+void save_extract_index() {
+    Manifest *manifest = load_bundle_manifest();
+    if (!manifest) return;
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.pyfuze-tmp.%d", extract_index_name, (int)getpid());
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        free_manifest(manifest);
+        return;
+    }
+    struct stat st;
+    for (size_t i = 0; i < manifest->count; i++) {
+        const char *path = manifest->entries[i].path;
+        if (imported_from_zip(path) || stat(path, &st) != 0) continue;
+        fprintf(file, "%llu\t%lld\t%ld\t%s\n", (unsigned long long)st.st_size, (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec, path);
+    }
+    free_manifest(manifest);
+
+    // without an index the next launch only compares sizes, nothing to fail for
+    if (fclose(file) != 0 || rename(tmp_path, extract_index_name) != 0) {
+        unlink(tmp_path);
+        debug_log("failed to write %s\n", extract_index_name);
+    }
+}
+
+// Start or resume the journal of an extraction. Workers append every file they put
+// in place, so when the extraction is interrupted the next launch of the same build
+// skips those files instead of starting over.
+void open_extract_journal(ExtractJournal *journal, const char *build_id) {
+    journal->data = NULL;
+    journal->paths = NULL;
+    journal->count = 0;
+
+    char header[MAX_BUILD_ID_LENGTH + 1];
+    snprintf(header, sizeof(header), "%.*s\n", (int)strcspn(build_id, "\r\n"), build_id);
+    size_t header_length = strlen(header);
+
+    char *data = read_text_file(extract_journal_name);
+    if (data && strncmp(data, header, header_length) == 0) {
+        journal->data = data;
+        journal->paths = malloc(sizeof(char *) * (count_lines(data) + 1));
+        if (!journal->paths) exit_with_message("Out of memory reading %s", extract_journal_name);
+        // a torn last line is dropped
+        char *line = data + header_length;
+        char *next;
+        for (; (next = strchr(line, '\n')) != NULL; line = next + 1) {
+            *next = '\0';
+            if (line[0]) journal->paths[journal->count++] = line;
+        }
+        qsort(journal->paths, journal->count, sizeof(char *), compare_paths);
+
+        journal->fd = open(extract_journal_name, O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (journal->fd != -1 && line[0]) write(journal->fd, "\n", 1);
+        if (journal->count) console_log("resuming extraction, %zu files already in place\n", journal->count);
+    } else {
+        free(data);
+        journal->fd = open(extract_journal_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (journal->fd != -1 && write(journal->fd, header, header_length) != (ssize_t)header_length) {
+            close(journal->fd);
+            journal->fd = -1;
+        }
+    }
+    if (journal->fd == -1) debug_log("failed to open %s, extraction can't be resumed\n", extract_journal_name);
+}
+
+int journal_contains(const ExtractJournal *journal, const char *path) {
+    if (journal->count == 0) return 0;
+    return bsearch(&path, journal->paths, journal->count, sizeof(char *), compare_paths) != NULL;
+}
+
+// The extraction completed, the journal has served its purpose
+void finish_extract_journal(ExtractJournal *journal) {
+    if (journal->fd != -1) close(journal->fd);
+    journal->fd = -1;
+    unlink(extract_journal_name);
+    free(journal->paths);
+    free(journal->data);
+    journal->paths = NULL;
+    journal->data = NULL;
+    journal->count = 0;
+}
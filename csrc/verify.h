@@ -0,0 +1,22 @@
+#pragma once
+
+#include "extract.h"
+#include "manifest.h"
+
+#define VERIFY_OFF 0
+#define VERIFY_STAT 1
+#define VERIFY_FULL 2
+
+typedef struct {
+    char* data;
+    char** paths;
+    size_t count;
+    int fd;
+} ExtractJournal;
+
+int verify_mode();
+int verify_extracted_files(const Manifest* manifest, ExtractPlan* plan, int mode);
+void save_extract_index();
+void open_extract_journal(ExtractJournal* journal, const char* build_id);
+int journal_contains(const ExtractJournal* journal, const char* path);
+void finish_extract_journal(ExtractJournal* journal);
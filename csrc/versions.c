@@ -0,0 +1,160 @@
+#include "versions.h"
+
+#include "dirent.h"
+#include "ftw.h"
+#include "libc/errno.h"
+#include "limits.h"
+#include "stdio.h"
+#include "string.h"
+#include "sys/file.h"
+#include "sys/stat.h"
+#include "unistd.h"
+#include "utils.h"
+
+#define MAX_VERSION_NAME 64
+
+// With versioned extraction unzip_path holds one directory per build plus a pointer
+// to the newest fully set up one:
+//
+//   <unzip_path>/current              name of the newest complete version
+//   <unzip_path>/<uuid>/              a former unzip_path: src, .venv, uv, python, ...
+//   <unzip_path>/<uuid>/.pyfuze.inuse share-locked by every process running the version
+//
+// Every executable runs the version it carries, current is informational: it tells
+// tools and scripts which build was set up last and keeps gc from removing the build
+// it replaced.
+const char *current_version_name = "current";
+const char *version_inuse_name = ".pyfuze.inuse";
+
+static char version_root[PATH_MAX] = {0};
+static char version_name[MAX_VERSION_NAME] = {0};
+static char previous_version_name[MAX_VERSION_NAME] = {0};
+
+// The build id is "<uuid> <timestamp> <utc offset>", the uuid alone names the directory.
+// A name that doesn't fit is rejected, truncating it could merge two builds.
+static void read_version_name(char *name, size_t name_size) {
+    char line[PATH_MAX];
+    FILE *file = fopen("/zip/.build_id.txt", "r");
+    if (!file) exit_with_message("Failed to read /zip/.build_id.txt");
+    if (!fgets(line, sizeof(line), file)) line[0] = '\0';
+    fclose(file);
+    size_t length = strcspn(line, " \t\r\n");
+    if (length == 0 || length >= name_size || line[0] == '.' || memchr(line, '/', length)) {
+        exit_with_message("Invalid build id in /zip/.build_id.txt");
+    }
+    memcpy(name, line, length);
+    name[length] = '\0';
+}
+
+// Called from init() with the working directory at unzip_path: switch into this
+// build's directory and register as a user of it. The share lock is held on an fd
+// that survives exec, so it lives exactly as long as the app does.
+void enter_version_dir() {
+    if (!getcwd(version_root, sizeof(version_root))) exit_with_message("getcwd failed");
+    read_version_name(version_name, sizeof(version_name));
+
+    char inuse_path[PATH_MAX];
+    snprintf(inuse_path, sizeof(inuse_path), "%s/%s", version_name, version_inuse_name);
+    for (;;) {
+        mkdir_recursive(version_name);
+        int fd = open(inuse_path, O_RDONLY | O_CREAT, 0644);
+        if (fd == -1) exit_with_message("Failed to open %s", inuse_path);
+        if (flock(fd, LOCK_SH) != 0) exit_with_message("Failed to lock %s", inuse_path);
+
+        // gc_versions() may have renamed the directory away between open and flock
+        struct stat locked, current;
+        fstat(fd, &locked);
+        if (stat(inuse_path, &current) == 0 && current.st_ino == locked.st_ino && current.st_dev == locked.st_dev) break;
+        close(fd);
+    }
+
+    if (chdir(version_name) != 0) exit_with_message("chdir %s failed", version_name);
+    if (!getcwd(config_unzip_path, sizeof(config_unzip_path))) exit_with_message("getcwd failed");
+}
+
+// Point current at this version once it is fully set up, via a temporary file and
+// rename so readers never see a partial name. Returns 1 if the pointer changed, the
+// version it named before is kept by the following gc.
+int publish_current_version() {
+    char current_path[PATH_MAX];
+    char existing[MAX_VERSION_NAME] = {0};
+    snprintf(current_path, sizeof(current_path), "%s/%s", version_root, current_version_name);
+
+    FILE *file = fopen(current_path, "r");
+    if (file) {
+        if (!fgets(existing, sizeof(existing), file)) existing[0] = '\0';
+        fclose(file);
+    }
+    if (strcmp(existing, version_name) == 0) return 0;
+    snprintf(previous_version_name, sizeof(previous_version_name), "%s", existing);
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", current_path, (int)getpid());
+    file = fopen(tmp_path, "w");
+    if (!file) exit_with_message("Failed to create %s", tmp_path);
+    fputs(version_name, file);
+    fclose(file);
+    if (rename(tmp_path, current_path) != 0) {
+        unlink(tmp_path);
+        exit_with_message("Failed to update %s", current_path);
+    }
+    console_log("switched %s to %s\n", current_path, version_name);
+    return 1;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    remove(path);
+    return 0;
+}
+
+static void remove_tree(const char *path) {
+    nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// Remove versions no process uses anymore. A version is in use while any process
+// holds the share lock on its inuse file, so an exclusive lock that succeeds right
+// away proves it is idle. The directory is renamed out of the way before deleting,
+// a late launcher of that version then starts over with a fresh extraction instead
+// of running from a half deleted tree. The version current named before this one is
+// kept, so two builds launched in turn don't delete and re-extract each other.
+void gc_versions() {
+    DIR *d = opendir(version_root);
+    if (!d) return;
+
+    char path[PATH_MAX];
+    char inuse_path[PATH_MAX];
+    char trash_path[PATH_MAX];
+    size_t removed = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, version_name) == 0 || strcmp(ent->d_name, previous_version_name) == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", version_root, ent->d_name);
+
+        // leftovers of a gc that was interrupted
+        if (strncmp(ent->d_name, ".trash-", 7) == 0) {
+            remove_tree(path);
+            continue;
+        }
+        if (ent->d_name[0] == '.' || strcmp(ent->d_name, current_version_name) == 0) continue;
+
+        snprintf(inuse_path, sizeof(inuse_path), "%s/%s", path, version_inuse_name);
+        int fd = open(inuse_path, O_RDONLY);
+        if (fd == -1) continue;
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            debug_log("version %s is still in use\n", ent->d_name);
+            close(fd);
+            continue;
+        }
+
+        snprintf(trash_path, sizeof(trash_path), "%s/.trash-%s", version_root, ent->d_name);
+        int renamed = rename(path, trash_path) == 0;
+        close(fd);
+        if (renamed) {
+            remove_tree(trash_path);
+            removed++;
+        }
+    }
+    closedir(d);
+
+    if (removed) console_log("removed %zu unused versions from %s\n", removed, version_root);
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+void enter_version_dir();
+int publish_current_version();
+void gc_versions();
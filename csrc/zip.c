@@ -0,0 +1,334 @@
+#include "zip.h"
+
+#include "fcntl.h"
+#include "libc/runtime/runtime.h"
+#include "pthread.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "third_party/zlib/zlib.h"
+#include "third_party/zstd/zstd.h"
+#include "unistd.h"
+
+#define EOCD_SIGNATURE 0x06054b50
+#define EOCD_SIZE 22
+#define EOCD_MAX_COMMENT 0xffff
+#define ZIP64_LOCATOR_SIGNATURE 0x07064b50
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EOCD_SIGNATURE 0x06064b50
+#define ZIP64_EOCD_SIZE 56
+#define CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define CENTRAL_HEADER_SIZE 46
+#define LOCAL_HEADER_SIGNATURE 0x04034b50
+#define LOCAL_HEADER_SIZE 30
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_UINT32_MAX 0xffffffffu
+#define DECODE_BUFFER_SIZE (256 * 1024)
+
+static ZipArchive self_zip;
+static int self_zip_ok = 0;
+static pthread_once_t self_zip_once = PTHREAD_ONCE_INIT;
+
+// One inflate state and one zstd context per extraction thread, created on first
+// use and reset between entries instead of allocating a new window for every file
+typedef struct {
+    z_stream stream;
+    int inflate_ready;
+    ZSTD_DCtx* zstd;
+    unsigned char buffer[DECODE_BUFFER_SIZE];
+} Decoder;
+
+static pthread_key_t decoder_key;
+static pthread_once_t decoder_key_once = PTHREAD_ONCE_INIT;
+
+static uint16_t read_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const unsigned char* p) {
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+static int write_full(int fd, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const ZipEntry*)a)->name, ((const ZipEntry*)b)->name);
+}
+
+// Apply the zip64 extended information extra field to values saturated at 0xffffffff
+static void apply_zip64_extra(ZipEntry* entry, const unsigned char* extra, size_t extra_len, uint32_t raw_offset) {
+    while (extra_len >= 4) {
+        uint16_t id = read_u16(extra);
+        uint16_t len = read_u16(extra + 2);
+        if ((size_t)len + 4 > extra_len) return;
+        if (id == ZIP64_EXTRA_ID) {
+            const unsigned char* p = extra + 4;
+            const unsigned char* end = p + len;
+            if (entry->size == ZIP_UINT32_MAX && p + 8 <= end) {
+                entry->size = read_u64(p);
+                p += 8;
+            }
+            if (entry->compressed_size == ZIP_UINT32_MAX && p + 8 <= end) {
+                entry->compressed_size = read_u64(p);
+                p += 8;
+            }
+            if (raw_offset == ZIP_UINT32_MAX && p + 8 <= end) {
+                entry->local_header_offset = read_u64(p);
+            }
+            return;
+        }
+        extra += 4 + len;
+        extra_len -= 4 + (size_t)len;
+    }
+}
+
+// Locate the central directory through the (zip64) end of central directory record
+static int find_central_directory(const unsigned char* map, uint64_t file_size, uint64_t* cd_offset, uint64_t* cd_size, uint64_t* count, uint64_t* base_offset) {
+    if (file_size < EOCD_SIZE) return -1;
+    uint64_t tail_size = EOCD_SIZE + EOCD_MAX_COMMENT;
+    if (tail_size > file_size) tail_size = file_size;
+    uint64_t tail_offset = file_size - tail_size;
+
+    int64_t eocd_position = -1;
+    for (uint64_t i = tail_size - EOCD_SIZE + 1; i-- > 0;) {
+        if (read_u32(map + tail_offset + i) == EOCD_SIGNATURE) {
+            eocd_position = (int64_t)(tail_offset + i);
+            break;
+        }
+    }
+    if (eocd_position < 0) return -1;
+
+    const unsigned char* e = map + eocd_position;
+    *count = read_u16(e + 10);
+    *cd_size = read_u32(e + 12);
+    *cd_offset = read_u32(e + 16);
+
+    // offsets are absolute in APE binaries, but tolerate data prepended to a plain zip
+    int64_t base = eocd_position - (int64_t)*cd_size - (int64_t)*cd_offset;
+
+    if (eocd_position >= ZIP64_LOCATOR_SIZE && read_u32(e - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+        uint64_t record_offset = read_u64(e - ZIP64_LOCATOR_SIZE + 8);
+        if (record_offset + ZIP64_EOCD_SIZE <= file_size && read_u32(map + record_offset) == ZIP64_EOCD_SIGNATURE) {
+            const unsigned char* record = map + record_offset;
+            *count = read_u64(record + 32);
+            *cd_size = read_u64(record + 40);
+            *cd_offset = read_u64(record + 48);
+            base = 0;
+        }
+    }
+
+    if (base < 0) return -1;
+    *base_offset = (uint64_t)base;
+    *cd_offset += (uint64_t)base;
+    return 0;
+}
+
+// Map the whole executable and parse its central directory once into a flat entry
+// array sorted by name. Entry data is read straight out of the mapping afterwards.
+static int index_archive(ZipArchive* archive, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return -1;
+    uint64_t file_size = (uint64_t)st.st_size;
+    void* map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return -1;
+    const unsigned char* data = (const unsigned char*)map;
+
+    uint64_t cd_offset, cd_size, count, base_offset;
+    if (find_central_directory(data, file_size, &cd_offset, &cd_size, &count, &base_offset) != 0 ||
+        cd_offset + cd_size > file_size) {
+        munmap(map, file_size);
+        return -1;
+    }
+
+    ZipEntry* entries = (ZipEntry*)malloc(sizeof(ZipEntry) * (count ? count : 1));
+    char* names = (char*)malloc(cd_size + 1);
+    if (!entries || !names) {
+        free(entries);
+        free(names);
+        munmap(map, file_size);
+        return -1;
+    }
+
+    const unsigned char* cd = data + cd_offset;
+    size_t n = 0;
+    size_t pos = 0;
+    char* name_out = names;
+    while (n < count && pos + CENTRAL_HEADER_SIZE <= cd_size) {
+        const unsigned char* h = cd + pos;
+        if (read_u32(h) != CENTRAL_HEADER_SIGNATURE) break;
+        uint16_t name_len = read_u16(h + 28);
+        uint16_t extra_len = read_u16(h + 30);
+        uint16_t comment_len = read_u16(h + 32);
+        if (pos + CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len > cd_size) break;
+
+        ZipEntry* entry = &entries[n];
+        entry->method = read_u16(h + 10);
+        entry->crc32 = read_u32(h + 16);
+        entry->compressed_size = read_u32(h + 20);
+        entry->size = read_u32(h + 24);
+        uint32_t raw_offset = read_u32(h + 42);
+        entry->local_header_offset = raw_offset;
+        apply_zip64_extra(entry, h + CENTRAL_HEADER_SIZE + name_len, extra_len, raw_offset);
+        entry->local_header_offset += base_offset;
+        entry->mode = read_u32(h + 38) >> 16;
+        if (entry->mode == 0) entry->mode = 0644;
+
+        memcpy(name_out, h + CENTRAL_HEADER_SIZE, name_len);
+        name_out[name_len] = '\0';
+        entry->name = name_out;
+        name_out += name_len + 1;
+
+        pos += CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
+        n++;
+    }
+
+    qsort(entries, n, sizeof(ZipEntry), compare_entries);
+    archive->fd = fd;
+    archive->map = data;
+    archive->map_size = file_size;
+    archive->entries = entries;
+    archive->count = n;
+    archive->names = names;
+    return 0;
+}
+
+static void open_self_zip_once() {
+    int fd = open(GetProgramExecutableName(), O_RDONLY);
+    if (fd == -1) return;
+    if (index_archive(&self_zip, fd) != 0) {
+        close(fd);
+        return;
+    }
+    self_zip_ok = 1;
+}
+
+// Index the zip central directory of our own executable once.
+// Returns NULL if it can't be read, callers then fall back to the /zip filesystem.
+const ZipArchive* open_self_zip() {
+    pthread_once(&self_zip_once, open_self_zip_once);
+    return self_zip_ok ? &self_zip : NULL;
+}
+
+// Binary search for the entry with the given name (relative to /zip)
+const ZipEntry* find_zip_entry(const ZipArchive* archive, const char* name) {
+    if (!archive || !name) return NULL;
+    ZipEntry key;
+    key.name = name;
+    return (const ZipEntry*)bsearch(&key, archive->entries, archive->count, sizeof(ZipEntry), compare_entries);
+}
+
+// Absolute file offset of the entry data, located through its local file header
+int64_t zip_entry_data_offset(const ZipArchive* archive, const ZipEntry* entry) {
+    if (entry->local_header_offset + LOCAL_HEADER_SIZE > archive->map_size) return -1;
+    const unsigned char* header = archive->map + entry->local_header_offset;
+    if (read_u32(header) != LOCAL_HEADER_SIGNATURE) return -1;
+    uint64_t offset = entry->local_header_offset + LOCAL_HEADER_SIZE + read_u16(header + 26) + read_u16(header + 28);
+    if (offset + entry->compressed_size > archive->map_size) return -1;
+    return (int64_t)offset;
+}
+
+static void free_decoder(void* arg) {
+    Decoder* decoder = (Decoder*)arg;
+    if (decoder->inflate_ready) inflateEnd(&decoder->stream);
+    ZSTD_freeDCtx(decoder->zstd);
+    free(decoder);
+}
+
+static void create_decoder_key() {
+    pthread_key_create(&decoder_key, free_decoder);
+}
+
+static Decoder* thread_decoder() {
+    pthread_once(&decoder_key_once, create_decoder_key);
+    Decoder* decoder = (Decoder*)pthread_getspecific(decoder_key);
+    if (decoder) return decoder;
+    decoder = (Decoder*)calloc(1, sizeof(Decoder));
+    if (!decoder) return NULL;
+    pthread_setspecific(decoder_key, decoder);
+    return decoder;
+}
+
+static int inflate_data(Decoder* decoder, const unsigned char* input, uint64_t input_left, int fd, uint64_t* written, uLong* crc) {
+    z_stream* stream = &decoder->stream;
+    if (!decoder->inflate_ready) {
+        // negative window bits: raw deflate data without a zlib header, as zip stores it
+        if (inflateInit2(stream, -MAX_WBITS) != Z_OK) return -1;
+        decoder->inflate_ready = 1;
+    } else {
+        inflateReset(stream);
+    }
+
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        if (stream->avail_in == 0 && input_left > 0) {
+            uInt chunk = input_left > UINT32_MAX ? UINT32_MAX : (uInt)input_left;
+            stream->next_in = (Bytef*)input;
+            stream->avail_in = chunk;
+            input += chunk;
+            input_left -= chunk;
+        }
+        stream->next_out = decoder->buffer;
+        stream->avail_out = sizeof(decoder->buffer);
+        ret = inflate(stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) return -1;
+        size_t produced = sizeof(decoder->buffer) - stream->avail_out;
+        if (write_full(fd, decoder->buffer, produced) != 0) return -1;
+        *crc = crc32(*crc, decoder->buffer, (uInt)produced);
+        *written += produced;
+    }
+    return 0;
+}
+
+// Stream the zstd frames of the entry through the reused decompression context.
+// The whole input is mapped, so only the output goes through the buffer.
+static int unzstd_data(Decoder* decoder, const unsigned char* input, uint64_t input_size, int fd, uint64_t* written, uLong* crc) {
+    if (!decoder->zstd && !(decoder->zstd = ZSTD_createDCtx())) return -1;
+    ZSTD_DCtx_reset(decoder->zstd, ZSTD_reset_session_only);
+
+    ZSTD_inBuffer in = {input, (size_t)input_size, 0};
+    size_t ret = 1;
+    while (in.pos < in.size || ret != 0) {
+        ZSTD_outBuffer out = {decoder->buffer, sizeof(decoder->buffer), 0};
+        size_t previous_pos = in.pos;
+        ret = ZSTD_decompressStream(decoder->zstd, &out, &in);
+        if (ZSTD_isError(ret)) return -1;
+        if (write_full(fd, decoder->buffer, out.pos) != 0) return -1;
+        *crc = crc32(*crc, decoder->buffer, (uInt)out.pos);
+        *written += out.pos;
+        // truncated frame: no input left and nothing more comes out
+        if (in.pos == in.size && previous_pos == in.pos && out.pos == 0 && ret != 0) return -1;
+    }
+    return 0;
+}
+
+// Decompress a deflated or zstd entry from the mapping into fd and check its size
+// and CRC-32. Returns 0 on success.
+int zip_decompress_entry(const ZipArchive* archive, const ZipEntry* entry, int fd) {
+    if (entry->method != ZIP_METHOD_DEFLATED && entry->method != ZIP_METHOD_ZSTD) return -1;
+    int64_t offset = zip_entry_data_offset(archive, entry);
+    if (offset < 0) return -1;
+    Decoder* decoder = thread_decoder();
+    if (!decoder) return -1;
+
+    const unsigned char* input = archive->map + offset;
+    uint64_t written = 0;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    int failed = entry->method == ZIP_METHOD_ZSTD
+                     ? unzstd_data(decoder, input, entry->compressed_size, fd, &written, &crc)
+                     : inflate_data(decoder, input, entry->compressed_size, fd, &written, &crc);
+    if (failed) return -1;
+    return written == entry->size && (uint32_t)crc == entry->crc32 ? 0 : -1;
+}
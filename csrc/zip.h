@@ -0,0 +1,32 @@
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATED 8
+#define ZIP_METHOD_ZSTD 93
+
+typedef struct {
+    const char* name;
+    uint16_t method;
+    uint32_t crc32;
+    uint64_t compressed_size;
+    uint64_t size;
+    uint64_t local_header_offset;
+    uint32_t mode;
+} ZipEntry;
+
+typedef struct {
+    int fd;
+    const unsigned char* map;
+    uint64_t map_size;
+    ZipEntry* entries;
+    size_t count;
+    char* names;
+} ZipArchive;
+
+const ZipArchive* open_self_zip();
+const ZipEntry* find_zip_entry(const ZipArchive* archive, const char* name);
+int64_t zip_entry_data_offset(const ZipArchive* archive, const ZipEntry* entry);
+int zip_decompress_entry(const ZipArchive* archive, const ZipEntry* entry, int fd);
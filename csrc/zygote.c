@@ -0,0 +1,234 @@
+#include "zygote.h"
+
+#include "fcntl.h"
+#include "libc/dce.h"
+#include "libc/errno.h"
+#include "limits.h"
+#include "signal.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "sys/wait.h"
+#include "trace.h"
+#include "unistd.h"
+#include "utils.h"
+
+// Client side of the fork server in src/pyfuze/zygote.py, which documents the protocol.
+// Both files live in unzip_path, the socket path is relative to stay under sun_path's limit.
+const char *zygote_script_name = ".pyfuze_zygote.py";
+const char *zygote_socket_name = ".pyfuze_zygote.sock";
+const char *zygote_log_name = ".pyfuze_zygote.log";
+
+#define ZYGOTE_MAGIC "PYFZ"
+#define ZYGOTE_STATUS_ACCEPTED 0
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+static volatile pid_t zygote_child = 0;
+
+// The child runs in the zygote's session, terminal signals only reach this process
+static void forward_signal(int sig) {
+    if (zygote_child > 0) kill(zygote_child, sig);
+}
+
+static void buffer_add(Buffer *buffer, const char *s) {
+    size_t len = strlen(s) + 1;
+    if (buffer->size + len > buffer->capacity) {
+        buffer->capacity = (buffer->size + len) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+        if (!buffer->data) exit_with_message("Out of memory");
+    }
+    memcpy(buffer->data + buffer->size, s, len);
+    buffer->size += len;
+}
+
+static void buffer_add_int(Buffer *buffer, long value) {
+    char s[32];
+    snprintf(s, sizeof(s), "%ld", value);
+    buffer_add(buffer, s);
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t size) {
+    char *p = data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int32_t read_le32(const unsigned char *p) {
+    return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static int connect_zygote() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", zygote_socket_name);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Start a detached zygote for later launches, this one carries on the normal way
+static void start_zygote(const char *venv_python, const char *build_id) {
+    char dir[PATH_MAX];
+    char script[PATH_MAX];
+    char entry[PATH_MAX];
+    char idle_timeout[32];
+    if (!getcwd(dir, sizeof(dir)) || !path_exists(zygote_script_name)) return;
+    path_join(script, sizeof(script), dir, zygote_script_name);
+    snprintf(entry, sizeof(entry), "%s/%s/%s", dir, src_dir, config_entry);
+    snprintf(idle_timeout, sizeof(idle_timeout), "%d", config_zygote_idle_timeout);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) return;
+    if (pid == 0) {
+        // new session and a second fork, so the zygote outlives us without a terminal
+        setsid();
+        if (fork() != 0) _exit(0);
+        int null_fd = open("/dev/null", O_RDWR);
+        int log_fd = open(zygote_log_name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        dup2(null_fd, 0);
+        dup2(null_fd, 1);
+        dup2(log_fd != -1 ? log_fd : null_fd, 2);
+        const char *args[] = {
+            venv_python, script,
+            "--dir", dir,
+            "--build-id", build_id,
+            "--entry", entry,
+            "--idle-timeout", idle_timeout,
+            "--preload", config_zygote_preload,
+            NULL,
+        };
+        execve(venv_python, (char *const *)args, environ);
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+    debug_log("started zygote for %s\n", dir);
+}
+
+// Hand this launch to a running zygote of the same build: it forks a child with the
+// modules already imported, which runs the entry on our stdio. Exits with the child's
+// exit code. Returns if there is no usable zygote (starting one for next time), so
+// the caller falls back to direct exec or uv run.
+void run_with_zygote(int argc, char *argv[]) {
+    if (IsWindows()) return;
+
+    char venv_python[PATH_MAX] = {0};
+    char build_id[MAX_BUILD_ID_LENGTH] = {0};
+    if (!prepare_venv_env(venv_python, sizeof(venv_python))) return;
+    read_build_id(build_id_name, build_id);
+
+    uint64_t start = TRACE_START();
+    int fd = connect_zygote();
+    if (fd == -1) {
+        start_zygote(venv_python, build_id);
+        return;
+    }
+
+    char cwd[PATH_MAX];
+    char run_dir[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        close(fd);
+        return;
+    }
+    path_join(run_dir, sizeof(run_dir), cwd, src_dir);
+
+    Buffer payload = {0};
+    buffer_add(&payload, build_id);
+    buffer_add(&payload, run_dir);
+    buffer_add_int(&payload, argc - 1);
+    for (int i = 1; i < argc; i++) buffer_add(&payload, argv[i]);
+    long envc = 0;
+    while (environ[envc]) envc++;
+    buffer_add_int(&payload, envc);
+    for (long i = 0; i < envc; i++) buffer_add(&payload, environ[i]);
+
+    unsigned char header[8];
+    uint32_t length = (uint32_t)payload.size;
+    memcpy(header, ZYGOTE_MAGIC, 4);
+    header[4] = length & 0xff;
+    header[5] = (length >> 8) & 0xff;
+    header[6] = (length >> 16) & 0xff;
+    header[7] = (length >> 24) & 0xff;
+
+    // stdin, stdout and stderr travel with the header
+    int fds[3] = {0, 1, 2};
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    struct iovec iov = {header, sizeof(header)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    fflush(stdout);
+    fflush(stderr);
+    int sent = sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(header) && write_all(fd, payload.data, payload.size) == 0;
+    free(payload.data);
+
+    unsigned char reply[8];
+    if (!sent || read_all(fd, reply, sizeof(reply)) != 0 || read_le32(reply) != ZYGOTE_STATUS_ACCEPTED) {
+        // stale build id or a dying zygote: it is shutting down, start a fresh one
+        debug_log("zygote declined the launch, falling back\n");
+        close(fd);
+        start_zygote(venv_python, build_id);
+        return;
+    }
+
+    zygote_child = (pid_t)read_le32(reply + 4);
+    struct sigaction sa = {0};
+    sa.sa_handler = forward_signal;
+    sigemptyset(&sa.sa_mask);
+    int forwarded[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGUSR1, SIGUSR2, SIGWINCH};
+    for (size_t i = 0; i < sizeof(forwarded) / sizeof(forwarded[0]); i++) {
+        sigaction(forwarded[i], &sa, NULL);
+    }
+    TRACE_PHASE("zygote handoff", start);
+
+    // the entry has started, from here on there is no falling back
+    unsigned char result[4];
+    int code = 1;
+    if (read_all(fd, result, sizeof(result)) == 0) {
+        code = read_le32(result);
+    } else {
+        fprintf(stderr, "lost connection to the pyfuze zygote\n");
+    }
+    close(fd);
+    trace_flush();
+    exit(code);
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void run_with_zygote(int argc, char *argv[]);
@@ -1,7 +1,6 @@
 from __future__ import annotations
 
 import os
-import zipfile
 from pathlib import Path
 from traceback import print_exc
 
@@ -66,6 +65,14 @@ Available modes:
     "unzip_path",
     help="Unzip path for bundle and online modes (default: /tmp/<project_name>)",
 )
+@click.option(
+    "--extract-threads",
+    "extract_threads",
+    type=int,
+    default=0,
+    show_default=True,
+    help="Number of threads used to extract files at runtime (0 means one per CPU core)",
+)
 @click.option(
     "--python",
     "python_version",
@@ -83,11 +90,157 @@ Available modes:
     type=click.Path(exists=True, dir_okay=False, path_type=Path),
     help="Include uv.lock file to lock dependencies",
 )
+@click.option(
+    "--compile-bytecode",
+    is_flag=True,
+    help="Precompile project, standard library and dependency bytecode with the bundled Python (bundle mode only)",
+)
+@click.option(
+    "--optimize",
+    type=click.IntRange(0, 2),
+    default=0,
+    show_default=True,
+    help="Optimization level for --compile-bytecode (1 strips asserts, 2 also docstrings), the executable runs Python at the same level",
+)
+@click.option(
+    "--ship-venv",
+    is_flag=True,
+    help="Ship the synced .venv in the executable so the first launch doesn't run `uv sync` (bundle mode only)",
+)
+@click.option(
+    "--drop-cache",
+    is_flag=True,
+    help="Leave the uv cache out of the executable, requires --ship-venv",
+)
+@click.option(
+    "--train-readahead",
+    is_flag=True,
+    help="Run the entry once at build time and record the files it reads at startup, the executable prefetches them in the background (bundle mode only)",
+)
+@click.option(
+    "--train-timeout",
+    type=click.IntRange(min=1),
+    default=10,
+    show_default=True,
+    help="Seconds the --train-readahead and --slim-verify runs may take before they are stopped",
+)
+@click.option(
+    "--zygote",
+    is_flag=True,
+    help="On Unix, keep a resident Python process with --preload modules imported that forks to serve later launches of the same build",
+)
+@click.option(
+    "--preload",
+    "preload",
+    multiple=True,
+    help="Module the --zygote process imports once up front (e.g. numpy) (repeatable)",
+)
+@click.option(
+    "--zygote-idle-timeout",
+    type=click.IntRange(min=1),
+    default=300,
+    show_default=True,
+    help="Seconds an idle --zygote process stays alive",
+)
 @click.option(
     "--win-gui",
     is_flag=True,
     help="Hide the console window on Windows",
 )
+@click.option(
+    "--direct-exec",
+    is_flag=True,
+    help="On Unix, exec the project's .venv Python directly instead of going through `uv run` (falls back to `uv run` if the venv is not usable)",
+)
+@click.option(
+    "--shared-store",
+    is_flag=True,
+    help="Hardlink extracted files from a host-wide content-addressed store ($XDG_CACHE_HOME/pyfuze/objects) so apps share identical files such as the Python runtime",
+)
+@click.option(
+    "--src-in-zip",
+    is_flag=True,
+    help="Import project modules directly from the executable via zipimport instead of extracting them (only the entry file and data files are extracted)",
+)
+@click.option(
+    "--versioned",
+    is_flag=True,
+    help="Extract each build to its own <unzip-path>/<build-id> directory so running processes keep their version during upgrades (unused old versions are removed automatically)",
+)
+@click.option(
+    "--store",
+    "store_patterns",
+    multiple=True,
+    help="Store matching files uncompressed in the executable, in addition to native libraries and already compressed files (glob, e.g. '*.bin') (repeatable)",
+)
+@click.option(
+    "--deflate",
+    "deflate_patterns",
+    multiple=True,
+    help="Always compress matching files, overriding --store and the built-in rules (glob) (repeatable)",
+)
+@click.option(
+    "--compression",
+    type=click.Choice(["deflate", "zstd"]),
+    default="deflate",
+    show_default=True,
+    help="Compression of the extracted payload (uv, python, cache, .venv), zstd decompresses several times faster at first launch and needs the zstandard package at build time",
+)
+@click.option(
+    "--compression-level",
+    type=int,
+    help="Level for --compression (deflate: 1-9, default 6; zstd: 1-22, default 9)",
+)
+@click.option(
+    "--compress-jobs",
+    type=click.IntRange(min=0),
+    default=0,
+    show_default=True,
+    help="Number of processes compressing the files added to the executable (0 means one per CPU core)",
+)
+@click.option(
+    "--build-id",
+    "build_id",
+    help="Use this build id instead of a random one and give every file in the executable the same timestamp (SOURCE_DATE_EPOCH or 1980-01-01), so identical inputs produce an identical executable",
+)
+@click.option(
+    "--build-cache",
+    "build_cache",
+    type=click.Path(file_okay=False, path_type=Path),
+    help="Directory caching the downloaded uv, Python and dependencies between bundle builds, keyed by platform, installer script, --env, .python-version and the dependency files [default: build/.pyfuze_cache]",
+)
+@click.option(
+    "--no-build-cache",
+    is_flag=True,
+    help="Download uv, Python and the dependencies again instead of using the build cache",
+)
+@click.option(
+    "--no-dedup",
+    is_flag=True,
+    help="Add every copy of identical files to the executable instead of storing the content once and hardlinking the copies at extraction",
+)
+@click.option(
+    "--slim",
+    is_flag=True,
+    help="Remove test suites, C headers, type stubs, docs, bytecode for other interpreters and installer leftovers from the dependencies and print what each package lost (bundle and portable modes)",
+)
+@click.option(
+    "--slim-keep",
+    "slim_keep",
+    multiple=True,
+    help="Keep matching dependency files despite --slim ([package:]glob, e.g. 'numpy:*/tests/*') (repeatable)",
+)
+@click.option(
+    "--slim-remove",
+    "slim_remove",
+    multiple=True,
+    help="Also remove matching dependency files with --slim ([package:]glob, e.g. '*.c') (repeatable)",
+)
+@click.option(
+    "--slim-verify",
+    is_flag=True,
+    help="Run the entry after --slim for up to --train-timeout seconds and fail the build if one of its imports fails",
+)
 @click.option(
     "--env",
     "env",
@@ -124,10 +277,37 @@ def cli(
     include: tuple[str, ...],
     exclude: tuple[str, ...],
     unzip_path: str,
+    extract_threads: int,
     python_version: str | None,
     pyproject: Path | None,
     uv_lock: Path | None,
+    compile_bytecode: bool,
+    optimize: int,
+    ship_venv: bool,
+    drop_cache: bool,
+    train_readahead: bool,
+    train_timeout: int,
+    zygote: bool,
+    preload: tuple[str, ...],
+    zygote_idle_timeout: int,
     win_gui: bool,
+    direct_exec: bool,
+    shared_store: bool,
+    src_in_zip: bool,
+    versioned: bool,
+    store_patterns: tuple[str, ...],
+    deflate_patterns: tuple[str, ...],
+    compression: str,
+    compression_level: int | None,
+    compress_jobs: int,
+    build_id: str | None,
+    build_cache: Path | None,
+    no_build_cache: bool,
+    no_dedup: bool,
+    slim: bool,
+    slim_keep: tuple[str, ...],
+    slim_remove: tuple[str, ...],
+    slim_verify: bool,
     env: tuple[str, ...],
     uv_install_script_windows: str,
     uv_install_script_unix: str,
@@ -156,6 +336,46 @@ def cli(
         unzip_path = unzip_path or f"/tmp/{project_name}"
         entry = python_project.name if python_project.is_file() else entry
         win_gui_num = 1 if win_gui else 0
+        if compile_bytecode and mode != "bundle":
+            click.secho("--compile-bytecode needs bundle mode, ignored", fg="yellow")
+            compile_bytecode = False
+        if ship_venv and mode != "bundle":
+            click.secho("--ship-venv needs bundle mode, ignored", fg="yellow")
+            ship_venv = False
+        if train_readahead and mode != "bundle":
+            click.secho("--train-readahead needs bundle mode, ignored", fg="yellow")
+            train_readahead = False
+        if compression == "zstd" and mode == "portable":
+            click.secho("--compression zstd needs bundle or online mode, ignored", fg="yellow")
+            compression = "deflate"
+        max_level = 22 if compression == "zstd" else 9
+        if compression_level is not None and not 1 <= compression_level <= max_level:
+            click.secho(
+                f"Invalid --compression-level for {compression}: {compression_level} (1-{max_level})",
+                fg="red",
+                bold=True,
+            )
+            raise SystemExit(1)
+        # the first word names the build's directory with --versioned
+        if build_id is not None and (
+            not build_id
+            or build_id[0] == "."
+            or build_id[0].isspace()
+            or any(c in build_id for c in "/\\\r\n")
+            or len(build_id.split()[0]) > BUILD_ID_NAME_MAX
+        ):
+            click.secho(f"Invalid --build-id: {build_id!r}", fg="red", bold=True)
+            raise SystemExit(1)
+        if drop_cache and not ship_venv:
+            click.secho("--drop-cache needs --ship-venv, ignored", fg="yellow")
+            drop_cache = False
+        if slim and mode == "online":
+            click.secho("--slim needs bundle or portable mode, ignored", fg="yellow")
+            slim = False
+        if slim_verify and not slim:
+            click.secho("--slim-verify needs --slim, ignored", fg="yellow")
+            slim_verify = False
+        slim_rules = SlimRules(slim_keep, slim_remove) if slim else None
 
         # create build and dist directories
         build_dir = Path("build").resolve()
@@ -163,6 +383,10 @@ def cli(
         dist_dir = Path("dist").resolve()
         dist_dir.mkdir(parents=True, exist_ok=True)
 
+        cache_dir = None
+        if not no_build_cache:
+            cache_dir = (build_cache or build_dir / ".pyfuze_cache").resolve()
+
         # exclude build and dist directories
         exclude = tuple(list(exclude) + ["build", "dist"])
 
@@ -190,11 +414,26 @@ def cli(
                 cp(uv_lock, temp_dir / "uv.lock")
                 click.secho(f"✓ wrote uv.lock", fg="green")
 
+            # write .pyfuze_zygote.py
+            if zygote:
+                cp(Path(__file__).parent / "zygote.py", temp_dir / ZYGOTE_SCRIPT_NAME)
+                click.secho(f"✓ wrote {ZYGOTE_SCRIPT_NAME}", fg="green")
+
             # write .pyfuze_config.txt
             config_list = [
                 f"unzip_path={unzip_path}",
                 f"entry={entry}",
                 f"win_gui={win_gui_num}",
+                f"extract_threads={extract_threads}",
+                f"direct_exec={1 if direct_exec else 0}",
+                f"shared_store={1 if shared_store else 0}",
+                f"src_in_zip={1 if src_in_zip else 0}",
+                f"versioned={1 if versioned else 0}",
+                f"compile_bytecode={1 if compile_bytecode else 0}",
+                f"optimize={optimize}",
+                f"zygote={1 if zygote else 0}",
+                f"zygote_preload={','.join(preload)}",
+                f"zygote_idle_timeout={zygote_idle_timeout}",
                 f"uv_install_script_windows={uv_install_script_windows}",
                 f"uv_install_script_unix={uv_install_script_unix}",
             ]
@@ -229,19 +468,73 @@ def cli(
                 env,
                 uv_install_script_windows,
                 uv_install_script_unix,
+                ship_venv,
+                drop_cache,
+                cache_dir,
             )
+            if slim_rules:
+                slim_bundle_deps(
+                    temp_dir,
+                    env,
+                    slim_rules,
+                    slim_verify,
+                    entry,
+                    optimize,
+                    train_timeout,
+                )
+            if ship_venv:
+                files, links, skipped = write_relocation_list(temp_dir)
+                click.secho(
+                    f"✓ wrote {RELOCATE_NAME} ({files} files, {links} links to relocate)",
+                    fg="green",
+                )
+                if skipped:
+                    click.secho(
+                        f"{skipped} binary files in .venv refer to the build directory and won't be relocated",
+                        fg="yellow",
+                    )
         elif mode == "portable":
             download_portable_deps(
                 temp_dir,
                 env,
                 uv_install_script_windows,
                 uv_install_script_unix,
+                slim_rules,
+                entry if slim_verify else None,
+                train_timeout,
             )
 
+        # precompile bytecode
+        if compile_bytecode:
+            compile_bundle_bytecode(temp_dir, env, optimize, src_in_zip)
+            click.secho(f"✓ compiled bytecode (optimize={optimize})", fg="green")
+
+        # record the startup working set
+        if train_readahead:
+            click.secho(f"training readahead ({train_timeout}s max)...", fg="green")
+            files = train_readahead_list(temp_dir, env, entry, optimize, train_timeout)
+            click.secho(f"✓ wrote {READAHEAD_NAME} ({files} files)", fg="green")
+
         # write .build_id.txt
-        (temp_dir / ".build_id.txt").write_text(gen_uuid_with_time())
+        (temp_dir / ".build_id.txt").write_text(build_id or gen_uuid_with_time())
         click.secho(f"✓ wrote .build_id.txt", fg="green")
 
+        # write .pyfuze_manifest.txt and the binary launch manifest
+        aliases: dict[str, str] = {}
+        if mode != "portable":
+            entries = collect_manifest_entries(temp_dir)
+            if not no_dedup:
+                aliases = dedup_entries(entries)
+                saved = sum(e[2] for e in entries if e[0] in aliases)
+                click.secho(
+                    f"✓ deduplicated {len(aliases)} files ({saved} bytes)", fg="green"
+                )
+            write_manifest(temp_dir, entries, aliases)
+            click.secho(f"✓ wrote {MANIFEST_NAME} ({len(entries)} files)", fg="green")
+            config_items = [tuple(c.split("=", 1)) for c in config_list]
+            write_binary_config(temp_dir, config_items, entries, aliases)
+            click.secho(f"✓ wrote {BINARY_CONFIG_NAME}", fg="green")
+
         # copy APE to dist directory
         output_path = dist_dir / output_name
         if mode == "portable":
@@ -250,10 +543,21 @@ def cli(
             copy_ape("pyfuze.com", output_path, win_gui)
 
         # add temp directory contents to output APE
-        with zipfile.ZipFile(output_path, "a", zipfile.ZIP_DEFLATED) as zf:
-            for item in temp_dir.rglob("*"):
-                if item.is_file():
-                    zf.write(item, str(item.relative_to(temp_dir)))
+        stored, aligned = write_bundle_zip(
+            output_path,
+            temp_dir,
+            store_patterns,
+            deflate_patterns,
+            compression,
+            compression_level,
+            compress_jobs,
+            reproducible_date_time() if build_id else None,
+            set(aliases),
+        )
+        click.secho(
+            f"✓ added files to {output_name} ({compression}, {stored} stored, {aligned} page aligned)",
+            fg="green",
+        )
 
         click.secho(f"Successfully packaged: {output_path}", fg="green", bold=True)
 
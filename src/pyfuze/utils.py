@@ -1,13 +1,23 @@
 from __future__ import annotations
 
+import csv
+import fnmatch
+import hashlib
 import os
+import platform
+import re
 import sys
 import shutil
+import struct
 import subprocess
+import zlib
 from pathlib import Path
-from typing import Any
+from typing import Any, Iterator
 import uuid
-from datetime import datetime
+import zipfile
+from collections import deque
+from concurrent.futures import ProcessPoolExecutor
+from datetime import datetime, timezone
 
 import click
 
@@ -216,6 +226,13 @@ def find_python_rel_path() -> str:
     raise ValueError("Python not found")
 
 
+def find_python_executable() -> str:
+    python_dir = Path(find_python_rel_path())
+    if os.name == "nt":
+        return str(python_dir / "python.exe")
+    return str(python_dir / "bin" / "python3")
+
+
 def get_uv_path() -> str:
     if os.name == "nt":
         return ".\\uv\\uv.exe"
@@ -225,7 +242,14 @@ def get_uv_path() -> str:
         raise ValueError(f"Unsupported platform: {os.name}")
 
 
-def download_deps() -> None:
+def sync_venv() -> None:
+    cmd = [get_uv_path(), "sync", "--python", find_python_rel_path()]
+    if Path("uv.lock").exists():
+        cmd.append("--frozen")
+    run_cmd(cmd)
+
+
+def download_deps(ship_venv: bool = False, drop_cache: bool = False) -> None:
     uv_path = get_uv_path()
 
     if not Path("pyproject.toml").exists():
@@ -246,13 +270,14 @@ def download_deps() -> None:
         rm("requirements.txt")
 
     # uv sync
-    cmd = [uv_path, "sync", "--python", find_python_rel_path()]
-    if Path("uv.lock").exists():
-        cmd.append("--frozen")
-    run_cmd(cmd)
+    sync_venv()
 
-    # rm .venv
-    rm(".venv")
+    if not ship_venv:
+        # rm .venv
+        rm(".venv")
+    elif drop_cache:
+        # the shipped .venv already holds every installed file
+        rm("cache")
 
 
 class DownloadEnv:
@@ -288,7 +313,11 @@ def download_portable_deps(
     env: tuple[str, ...],
     uv_install_script_windows: str,
     uv_install_script_unix: str,
+    slim: SlimRules | None = None,
+    verify_entry: str | None = None,
+    verify_timeout: float = 10,
 ) -> None:
+    dest_dir = Path(os.path.realpath(dest_dir))
     with DownloadEnv(dest_dir, env):
         if Path("requirements.txt").exists():
             download_uv(uv_install_script_windows, uv_install_script_unix)
@@ -313,27 +342,1111 @@ def download_portable_deps(
                 ]
             )
             rm("requirements.txt")
+            rm("cache")
+
+            if slim:
+                # python.com imports through zipimport, which ignores __pycache__
+                print_slim_report(slim_dependencies(dest_dir, slim, None))
+                if verify_entry:
+                    # the downloaded Python stands in for python.com
+                    run_env = os.environ.copy()
+                    run_env["PYTHONPATH"] = str(dest_dir / site_packages_path)
+                    verify_entry_imports(
+                        dest_dir,
+                        str(dest_dir / find_python_executable()),
+                        verify_entry,
+                        run_env,
+                        verify_timeout,
+                    )
 
             rm("uv")
-            rm("cache")
             rm("python")
 
             click.secho(f"✓ downloaded dependencies", fg="green")
 
 
+# --slim rules, globs matched like --store/--deflate patterns against a file's path
+# inside its package root (a site-packages directory or an unpacked wheel in the uv
+# cache) and against its name
+SLIM_DEFAULT_PATTERNS = (
+    # test suites
+    "tests/*",
+    "*/tests/*",
+    "conftest.py",
+    # C headers and Cython declarations, only used to build extensions
+    "*.h",
+    "*.hpp",
+    "*.hh",
+    "*.pxd",
+    # type stubs
+    "*.pyi",
+    # documentation
+    "docs/*",
+    "*/docs/*",
+    "*.rst",
+    "*.md",
+)
+# metadata read by importlib.metadata and uv, and licenses
+SLIM_DEFAULT_KEEP = (
+    "*.dist-info/*",
+    "*.egg-info/*",
+    "LICENSE*",
+    "LICENCE*",
+    "COPYING*",
+    "NOTICE*",
+    "AUTHORS*",
+)
+# what uv leaves behind after installing, relative to the build directory: build
+# environments and interpreter info of the build host, venv activation scripts and
+# the console scripts of a --target install, which point at the build's Python
+SLIM_LEFTOVERS = (
+    "cache/builds-v*",
+    "cache/interpreter-v*",
+    "cache/.tmp*",
+    ".venv/bin/activate*",
+    ".venv/Scripts/activate*",
+    ".venv/Scripts/deactivate.bat",
+    "Lib/site-packages/bin",
+)
+SLIM_LEFTOVERS_NAME = "(installer leftovers)"
+
+
+def normalize_package_name(name: str) -> str:
+    return re.sub(r"[-_.]+", "-", name).lower()
+
+
+def parse_slim_pattern(pattern: str) -> tuple[str | None, str]:
+    package, sep, glob = pattern.partition(":")
+    if not sep:
+        return None, pattern
+    return normalize_package_name(package), glob
+
+
+# The default rules remove test suites, headers, stubs, docs and bytecode compiled
+# for another interpreter. --slim-keep patterns win over everything, --slim-remove
+# patterns over the defaults. A pattern may be limited to one distribution with a
+# "<name>:" prefix.
+class SlimRules:
+    def __init__(self, keep: tuple[str, ...] = (), remove: tuple[str, ...] = ()):
+        self.keep = [parse_slim_pattern(p) for p in keep]
+        self.remove = [parse_slim_pattern(p) for p in remove]
+
+    @staticmethod
+    def matches(
+        patterns: list[tuple[str | None, str]], package: str, rel_path: str
+    ) -> bool:
+        return any(
+            (p is None or p == package) and matches_any(rel_path, (glob,))
+            for p, glob in patterns
+        )
+
+    # cache_tag None removes all bytecode, zipimport never reads __pycache__
+    def removes(self, package: str, rel_path: str, cache_tag: str | None) -> bool:
+        if self.matches(self.keep, package, rel_path):
+            return False
+        if self.matches(self.remove, package, rel_path):
+            return True
+        if matches_any(rel_path, SLIM_DEFAULT_KEEP):
+            return False
+        parts = rel_path.split("/")
+        if len(parts) > 1 and parts[-2] == "__pycache__" and parts[-1].endswith(".pyc"):
+            if cache_tag is None or f".{cache_tag}." not in parts[-1]:
+                return True
+        return matches_any(rel_path, SLIM_DEFAULT_PATTERNS)
+
+
+def python_cache_tag(python: str) -> str:
+    return subprocess.check_output(
+        [python, "-c", "import sys; print(sys.implementation.cache_tag)"], text=True
+    ).strip()
+
+
+def package_roots(dest_dir: Path) -> list[Path]:
+    patterns = (
+        ".venv/lib/python*/site-packages",
+        ".venv/Lib/site-packages",
+        "Lib/site-packages",
+        "cache/archive-v0/*",
+    )
+    roots = [p for pattern in patterns for p in dest_dir.glob(pattern)]
+    return sorted(p for p in roots if p.is_dir())
+
+
+# "<name>-<version>.dist-info"
+def distribution_name(dist_info: Path) -> str:
+    return normalize_package_name(dist_info.name[: -len(".dist-info")].split("-")[0])
+
+
+# Map the files of a package root to the distribution installing them, by the RECORD
+# of every .dist-info in it
+def distribution_owners(root: Path) -> dict[str, str]:
+    owners: dict[str, str] = {}
+    for dist_info in sorted(root.glob("*.dist-info")):
+        record = dist_info / "RECORD"
+        if not record.is_file():
+            continue
+        name = distribution_name(dist_info)
+        with open(record, encoding="utf-8", newline="") as f:
+            for row in csv.reader(f):
+                if row and not row[0].startswith(("../", "/")):
+                    owners[row[0]] = name
+    return owners
+
+
+def remove_slimmed_file(
+    path: Path, report: dict[str, list[int]], package: str
+) -> None:
+    size = path.lstat().st_size
+    path.unlink()
+    totals = report.setdefault(package, [0, 0])
+    totals[0] += 1
+    totals[1] += size
+
+
+# Remove the files the rules match from the dependency trees of dest_dir and the
+# installer leftovers. Returns the files and bytes removed per distribution.
+# Runs before the manifest, relocation list and bytecode steps look at the tree.
+def slim_dependencies(
+    dest_dir: Path, rules: SlimRules, cache_tag: str | None
+) -> dict[str, list[int]]:
+    report: dict[str, list[int]] = {}
+    for pattern in SLIM_LEFTOVERS:
+        for path in sorted(dest_dir.glob(pattern)):
+            if path.is_dir() and not path.is_symlink():
+                for item in sorted(path.rglob("*")):
+                    if item.is_file() or item.is_symlink():
+                        remove_slimmed_file(item, report, SLIM_LEFTOVERS_NAME)
+                shutil.rmtree(path)
+            else:
+                remove_slimmed_file(path, report, SLIM_LEFTOVERS_NAME)
+
+    for root in package_roots(dest_dir):
+        owners = distribution_owners(root)
+        emptied: set[Path] = set()
+        for path in sorted(root.rglob("*")):
+            if path.is_dir() and not path.is_symlink():
+                continue
+            rel_path = path.relative_to(root).as_posix()
+            # files no RECORD lists go by their top-level module
+            top = rel_path.split("/", 1)[0].split(".", 1)[0]
+            package = owners.get(rel_path) or normalize_package_name(top)
+            if rules.removes(package, rel_path, cache_tag):
+                remove_slimmed_file(path, report, package)
+                emptied.add(path.parent)
+        # drop the directories left empty, deepest first
+        for directory in sorted(emptied, key=lambda p: len(p.parts), reverse=True):
+            while (
+                directory != root
+                and directory.exists()
+                and not any(directory.iterdir())
+            ):
+                directory.rmdir()
+                directory = directory.parent
+    return report
+
+
+def print_slim_report(report: dict[str, list[int]]) -> None:
+    files = sum(totals[0] for totals in report.values())
+    size = sum(totals[1] for totals in report.values())
+    click.secho(f"✓ slimmed dependencies ({files} files, {size} bytes)", fg="green")
+    # largest savings first
+    for package, (count, removed) in sorted(
+        report.items(), key=lambda item: (-item[1][1], item[0])
+    ):
+        click.secho(f"  {package}: {count} files, {removed} bytes")
+
+
+# Runs the entry and records an ImportError escaping it to $PYFUZE_VERIFY_OUT
+SLIM_VERIFIER = """
+import os, runpy, sys, traceback
+out = os.environ.pop("PYFUZE_VERIFY_OUT")
+entry = os.path.abspath(sys.argv[1])
+sys.argv = sys.argv[1:]
+sys.path[0] = os.path.dirname(entry)
+try:
+    runpy.run_path(entry, run_name="__main__")
+except ImportError as exc:
+    with open(out, "w", encoding="utf-8") as f:
+        f.write("".join(traceback.format_exception_only(type(exc), exc)).strip())
+    raise
+"""
+
+
+# Run the entry like the executable would, for at most timeout seconds, and fail the
+# build if an import it doesn't handle itself fails. A run still going at the
+# timeout got past its imports.
+def verify_entry_imports(
+    dest_dir: Path, python: str, entry: str, run_env: dict[str, str], timeout: float
+) -> None:
+    result_path = dest_dir.parent / f"{dest_dir.name}.verify"
+    rm(result_path)
+    run_env = dict(run_env)
+    run_env["PYFUZE_VERIFY_OUT"] = str(result_path)
+    run_env["PYTHONDONTWRITEBYTECODE"] = "1"
+    run_entry(
+        [python, "-c", SLIM_VERIFIER, str(dest_dir / "src" / entry)],
+        dest_dir / "src",
+        run_env,
+        timeout,
+    )
+    if result_path.exists():
+        error = result_path.read_text(encoding="utf-8")
+        rm(result_path)
+        raise RuntimeError(
+            f"{entry} failed to import after slimming: {error}\n"
+            "Keep the files it needs with --slim-keep"
+        )
+    click.secho(f"✓ verified the imports of {entry}", fg="green")
+
+
+# Slim a bundle build's uv cache and shipped .venv, keeping the bytecode of the
+# bundled Python, and run the entry in a synced venv if verify is set
+def slim_bundle_deps(
+    dest_dir: Path,
+    env: tuple[str, ...],
+    rules: SlimRules,
+    verify: bool,
+    entry: str,
+    optimize: int,
+    timeout: float,
+) -> None:
+    dest_dir = Path(os.path.realpath(dest_dir))
+    with DownloadEnv(dest_dir, env):
+        cache_tag = python_cache_tag(find_python_executable())
+        print_slim_report(slim_dependencies(dest_dir, rules, cache_tag))
+        if not verify:
+            return
+
+        shipped_venv = Path(".venv").exists()
+        if not shipped_venv:
+            sync_venv()
+        run_env = os.environ.copy()
+        run_env["VIRTUAL_ENV"] = str(dest_dir / ".venv")
+        if optimize:
+            run_env["PYTHONOPTIMIZE"] = str(optimize)
+        try:
+            verify_entry_imports(
+                dest_dir, str(dest_dir / find_venv_python()), entry, run_env, timeout
+            )
+        finally:
+            if not shipped_venv:
+                rm(".venv")
+
+
+BUILD_CACHE_FORMAT = 1
+
+
+def file_digest(path: str | Path) -> str | None:
+    path = Path(path)
+    if not path.is_file():
+        return None
+    return hashlib.sha256(path.read_bytes()).hexdigest()
+
+
+def cache_key(*parts: Any) -> str:
+    h = hashlib.sha256()
+    for part in parts:
+        h.update(repr(part).encode("utf-8"))
+        h.update(b"\0")
+    return h.hexdigest()[:32]
+
+
+def link_or_copy(src: str, dst: str) -> str:
+    try:
+        os.link(src, dst)
+    except OSError:
+        shutil.copy2(src, dst)
+    return dst
+
+
+# Persistent cache of the uv/, python/ and cache/ layers of bundle builds, one
+# <layer>-<key> directory per layer. Each key hashes everything its download depends
+# on, including the key of the layer below, so a change invalidates the layers above
+# it. Files are hardlinked in and out when possible, every later build step replaces
+# files instead of writing into them.
+class BuildCache:
+    def __init__(self, root: Path | None):
+        self.root = root
+
+    def restore(self, layer: str, key: str) -> bool:
+        if self.root is None:
+            return False
+        layer_dir = self.root / f"{layer}-{key}"
+        if not layer_dir.is_dir():
+            return False
+        for item in layer_dir.iterdir():
+            rm(item.name)
+            if item.is_dir() and not item.is_symlink():
+                shutil.copytree(
+                    item, item.name, symlinks=True, copy_function=link_or_copy
+                )
+            else:
+                link_or_copy(str(item), item.name)
+        return True
+
+    def save(self, layer: str, key: str, names: list[str]) -> None:
+        if self.root is None:
+            return
+        layer_dir = self.root / f"{layer}-{key}"
+        if layer_dir.exists():
+            return
+        # populated next to its final name and renamed, concurrent builds may race
+        tmp_dir = self.root / f".tmp-{layer}-{key}-{os.getpid()}"
+        rm(tmp_dir)
+        tmp_dir.mkdir(parents=True)
+        try:
+            for name in names:
+                path = Path(name)
+                if path.is_dir() and not path.is_symlink():
+                    shutil.copytree(
+                        path, tmp_dir / name, symlinks=True, copy_function=link_or_copy
+                    )
+                elif path.exists() or path.is_symlink():
+                    link_or_copy(name, str(tmp_dir / name))
+            os.rename(tmp_dir, layer_dir)
+        except OSError:
+            if not layer_dir.exists():
+                raise
+        finally:
+            rm(tmp_dir)
+
+
+def installer_source(
+    uv_install_script_windows: str, uv_install_script_unix: str
+) -> str:
+    script = uv_install_script_windows if os.name == "nt" else uv_install_script_unix
+    # a local script is keyed by its content, a URL by itself
+    digest = file_digest(script)
+    return f"sha256:{digest}" if digest else script
+
+
 def download_uv_python_deps(
     dest_dir: Path,
     env: tuple[str, ...],
     uv_install_script_windows: str,
     uv_install_script_unix: str,
+    ship_venv: bool = False,
+    drop_cache: bool = False,
+    cache_dir: Path | None = None,
 ) -> None:
+    cache = BuildCache(cache_dir)
     with DownloadEnv(dest_dir, env):
-        download_uv(uv_install_script_windows, uv_install_script_unix)
-        click.secho(f"✓ downloaded uv", fg="green")
-        download_python()
-        click.secho(f"✓ downloaded python", fg="green")
-        download_deps()
-        click.secho(f"✓ downloaded dependencies", fg="green")
+        uv_key = cache_key(
+            BUILD_CACHE_FORMAT,
+            sys.platform,
+            platform.machine(),
+            sorted(env),
+            installer_source(uv_install_script_windows, uv_install_script_unix),
+        )
+        if cache.restore("uv", uv_key):
+            click.secho(f"✓ restored uv from the build cache", fg="green")
+        else:
+            download_uv(uv_install_script_windows, uv_install_script_unix)
+            cache.save("uv", uv_key, ["uv"])
+            click.secho(f"✓ downloaded uv", fg="green")
+
+        python_key = cache_key(uv_key, file_digest(".python-version"))
+        if cache.restore("python", python_key):
+            click.secho(f"✓ restored python from the build cache", fg="green")
+        else:
+            download_python()
+            cache.save("python", python_key, ["python"])
+            click.secho(f"✓ downloaded python", fg="green")
+
+        deps_key = cache_key(
+            python_key,
+            file_digest("pyproject.toml"),
+            file_digest("uv.lock"),
+            file_digest("requirements.txt"),
+            ship_venv,
+            drop_cache,
+            # the venv refers to its absolute location
+            str(dest_dir) if ship_venv else None,
+        )
+        deps_layer = ["cache", ".venv", "pyproject.toml", "uv.lock"]
+        if cache.restore("deps", deps_key):
+            rm("requirements.txt")
+            click.secho(f"✓ restored dependencies from the build cache", fg="green")
+        else:
+            download_deps(ship_venv, drop_cache)
+            cache.save("deps", deps_key, deps_layer)
+            click.secho(f"✓ downloaded dependencies", fg="green")
+
+
+def compile_bundle_bytecode(
+    dest_dir: Path, env: tuple[str, ...], optimize: int, src_in_zip: bool
+) -> None:
+    # compiled by the bundled interpreter so the magic number matches the runtime,
+    # unchecked-hash pycs don't record the source mtime and stay valid after extraction
+    with DownloadEnv(dest_dir, env):
+        cmd = [find_python_executable()]
+        cmd += ["-O"] * optimize
+        cmd += ["-m", "compileall", "-q", "-f", "-j", "0"]
+        cmd += ["--invalidation-mode", "unchecked-hash"]
+
+        trees = ["python"]
+        if Path("cache/archive-v0").exists():
+            trees.append("cache/archive-v0")
+        if Path(".venv").exists():
+            trees.append(".venv")
+        run_cmd(cmd + trees)
+
+        # zipimport only looks for legacy pycs next to the sources
+        run_cmd(cmd + (["-b", "src"] if src_in_zip else ["src"]))
+
+
+READAHEAD_NAME = ".pyfuze_readahead.txt"
+# Runs the entry under an audit hook and appends every file it opens to
+# $PYFUZE_READAHEAD_OUT as soon as it is opened, so a run cut short by the
+# timeout still leaves its list. Shared libraries mapped by the dynamic linker
+# never raise "open" events, they are taken from /proc/self/maps at exit.
+READAHEAD_TRAINER = """
+import atexit, os, runpy, signal, sys
+out = open(os.environ.pop("PYFUZE_READAHEAD_OUT"), "a", buffering=1)
+seen = set()
+def record(path):
+    path = os.path.abspath(path)
+    if path not in seen:
+        seen.add(path)
+        out.write(path + "\\n")
+def hook(event, args):
+    if event == "open" and isinstance(args[0], str):
+        record(args[0])
+def record_maps():
+    try:
+        with open("/proc/self/maps") as maps:
+            for line in maps:
+                parts = line.split(None, 5)
+                if len(parts) == 6 and parts[5].startswith("/"):
+                    record(parts[5].strip())
+    except OSError:
+        pass
+sys.addaudithook(hook)
+atexit.register(record_maps)
+signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+entry = os.path.abspath(sys.argv[1])
+sys.argv = sys.argv[1:]
+sys.path[0] = os.path.dirname(entry)
+runpy.run_path(entry, run_name="__main__")
+"""
+
+
+# Run a build-time copy of the app, stopped after timeout seconds
+def run_entry(cmd: list[str], cwd: Path, env: dict[str, str], timeout: float) -> None:
+    process = subprocess.Popen(cmd, cwd=cwd, env=env, stdin=subprocess.DEVNULL)
+    try:
+        process.wait(timeout)
+    except subprocess.TimeoutExpired:
+        process.terminate()
+        try:
+            process.wait(5)
+        except subprocess.TimeoutExpired:
+            process.kill()
+            process.wait()
+
+
+def find_venv_python() -> str:
+    if os.name == "nt":
+        return str(Path(".venv") / "Scripts" / "python.exe")
+    return str(Path(".venv") / "bin" / "python")
+
+
+# Record which bundled files a training run of the entry opens, in first-open order.
+# The launcher prefetches them into the page cache on a background thread.
+def train_readahead_list(
+    dest_dir: Path, env: tuple[str, ...], entry: str, optimize: int, timeout: float
+) -> int:
+    dest_dir = Path(os.path.realpath(dest_dir))
+    record_path = dest_dir.parent / f"{dest_dir.name}.readahead"
+    rm(record_path)
+
+    with DownloadEnv(dest_dir, env):
+        shipped_venv = Path(".venv").exists()
+        if not shipped_venv:
+            sync_venv()
+
+        run_env = os.environ.copy()
+        run_env["PYFUZE_READAHEAD_OUT"] = str(record_path)
+        run_env["PYTHONDONTWRITEBYTECODE"] = "1"
+        run_env["VIRTUAL_ENV"] = str(dest_dir / ".venv")
+        if optimize:
+            run_env["PYTHONOPTIMIZE"] = str(optimize)
+        # long running apps are trained on their startup only
+        run_entry(
+            [
+                str(dest_dir / find_venv_python()),
+                "-c",
+                READAHEAD_TRAINER,
+                str(dest_dir / "src" / entry),
+            ],
+            dest_dir / "src",
+            run_env,
+            timeout,
+        )
+
+        if not shipped_venv:
+            rm(".venv")
+
+    paths = []
+    if record_path.exists():
+        for line in record_path.read_text(encoding="utf-8").splitlines():
+            try:
+                rel_path = Path(os.path.realpath(line)).relative_to(dest_dir).as_posix()
+            except ValueError:
+                continue
+            if rel_path not in paths and (dest_dir / rel_path).is_file():
+                paths.append(rel_path)
+        rm(record_path)
+
+    (dest_dir / READAHEAD_NAME).write_text(
+        "".join(p + "\n" for p in paths), encoding="utf-8"
+    )
+    return len(paths)
+
+
+MANIFEST_NAME = ".pyfuze_manifest.txt"
+BINARY_CONFIG_NAME = ".pyfuze_config.bin"
+RELOCATE_NAME = ".pyfuze_relocate.txt"
+ZYGOTE_SCRIPT_NAME = ".pyfuze_zygote.py"
+# files consumed by the launcher itself and never extracted
+MANIFEST_EXCLUDES = {
+    ".pyfuze_config.txt",
+    ".build_id.txt",
+    MANIFEST_NAME,
+    BINARY_CONFIG_NAME,
+    RELOCATE_NAME,
+    READAHEAD_NAME,
+}
+# text files with the build path in them larger than this are left alone
+RELOCATE_MAX_SIZE = 1024 * 1024
+
+
+# Symlinks in the shipped .venv (e.g. bin/python -> the bundled interpreter) can't be
+# stored in the zip, the launcher recreates them from the relocation list.
+def venv_links(dest_dir: Path) -> list[str]:
+    links = []
+    for root, dirs, files in os.walk(dest_dir / ".venv"):
+        for name in dirs + files:
+            path = Path(root) / name
+            if path.is_symlink():
+                links.append(path.relative_to(dest_dir).as_posix())
+    return sorted(links)
+
+
+def is_under_link(rel_path: str, links: list[str]) -> bool:
+    return any(rel_path == link or rel_path.startswith(link + "/") for link in links)
+
+
+# Relocation list for the launcher to move the shipped .venv from the build directory
+# to unzip_path, one tab separated record per line:
+#   prefix <build directory>
+#   file   <text file containing the build directory>
+#   link   <symlink> <target, "@" stands for unzip_path>
+def write_relocation_list(dest_dir: Path) -> tuple[int, int, int]:
+    # uv may have written the canonical path of the build directory
+    prefixes = sorted({str(dest_dir), os.path.realpath(dest_dir)}, key=len, reverse=True)
+    prefixes_bytes = [p.encode("utf-8") for p in prefixes]
+    links = venv_links(dest_dir)
+    lines = [f"prefix\t{p}" for p in prefixes]
+    files = skipped = 0
+
+    for root, dirs, names in os.walk(dest_dir / ".venv"):
+        for name in names:
+            path = Path(root) / name
+            rel_path = path.relative_to(dest_dir).as_posix()
+            if path.is_symlink() or is_under_link(rel_path, links):
+                continue
+            # the import system fixes up code object file names on its own
+            if path.suffix == ".pyc" or path.stat().st_size > RELOCATE_MAX_SIZE:
+                continue
+            data = path.read_bytes()
+            if not any(p in data for p in prefixes_bytes):
+                continue
+            if b"\0" in data:
+                # e.g. console script launchers on Windows, they keep the build path
+                skipped += 1
+                continue
+            lines.append(f"file\t{rel_path}")
+            files += 1
+
+    for link in links:
+        target = os.readlink(dest_dir / link)
+        for p in prefixes:
+            if os.path.isabs(target) and is_subpath(Path(target), Path(p)):
+                target = "@" + Path(target).relative_to(p).as_posix()
+                break
+        lines.append(f"link\t{link}\t{target}")
+
+    (dest_dir / RELOCATE_NAME).write_text("\n".join(lines) + "\n", encoding="utf-8")
+    return files, len(links), skipped
+
+
+def file_crc32_sha256(path: Path) -> tuple[int, str]:
+    crc = 0
+    sha256 = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1024 * 1024), b""):
+            crc = zlib.crc32(chunk, crc)
+            sha256.update(chunk)
+    return crc, sha256.hexdigest()
+
+
+# (path, crc32, size, mode, sha256) of every extracted file, sorted by path
+def collect_manifest_entries(dest_dir: Path) -> list[tuple[str, int, int, int, str]]:
+    entries = []
+    links = venv_links(dest_dir)
+    for item in dest_dir.rglob("*"):
+        if not item.is_file():
+            continue
+        rel_path = item.relative_to(dest_dir).as_posix()
+        if rel_path in MANIFEST_EXCLUDES or is_under_link(rel_path, links):
+            continue
+        st = item.stat()
+        crc, sha256 = file_crc32_sha256(item)
+        entries.append((rel_path, crc, st.st_size, st.st_mode & 0o7777, sha256))
+    entries.sort()
+    return entries
+
+
+# Files the launcher only extracts, never reads through /zip or imports through
+# zipimport, which both only know stored and deflated entries
+PAYLOAD_PREFIXES = ("uv/", "python/", "cache/", ".venv/")
+# smaller duplicates cost about as much to link as to extract
+DEDUP_MIN_SIZE = 256
+
+
+# Map every payload file whose content and mode another one already has to the first
+# of them in path order. Only that one is added to the executable, the launcher links
+# the others to it.
+def dedup_entries(entries: list[tuple[str, int, int, int, str]]) -> dict[str, str]:
+    sources: dict[tuple[str, int], str] = {}
+    aliases: dict[str, str] = {}
+    for rel_path, crc, size, mode, sha256 in entries:
+        if size < DEDUP_MIN_SIZE or not rel_path.startswith(PAYLOAD_PREFIXES):
+            continue
+        # the text manifest separates the source path with a tab
+        if "\t" in rel_path:
+            continue
+        source = sources.setdefault((sha256, mode), rel_path)
+        if source != rel_path:
+            aliases[rel_path] = source
+    return aliases
+
+
+# one "<crc32>\t<size>\t<mode>\t<sha256>\t<path>[\t<source path>]" line per extracted
+# file, the source is the file with the same content stored in the executable
+def write_manifest(
+    dest_dir: Path,
+    entries: list[tuple[str, int, int, int, str]],
+    aliases: dict[str, str] | None = None,
+) -> None:
+    aliases = aliases or {}
+    with open(dest_dir / MANIFEST_NAME, "w", encoding="utf-8", newline="\n") as f:
+        for rel_path, crc, size, mode, sha256 in entries:
+            source = f"\t{aliases[rel_path]}" if rel_path in aliases else ""
+            f.write(f"{crc:08x}\t{size}\t{mode:o}\t{sha256}\t{rel_path}{source}\n")
+
+
+def fnv1a32(data: bytes) -> int:
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+# Binary launch manifest read zero-copy by the launcher, see csrc/config.c for the layout.
+# It must be stored uncompressed so the launcher can mmap it out of the executable.
+def write_binary_config(
+    dest_dir: Path,
+    config_items: list[tuple[str, str]],
+    entries: list[tuple[str, int, int, int, str]],
+    aliases: dict[str, str] | None = None,
+) -> None:
+    aliases = aliases or {}
+    strings = bytearray()
+    string_offsets: dict[bytes, int] = {}
+
+    def add_string(value: str) -> tuple[int, int]:
+        data = value.encode("utf-8")
+        if data not in string_offsets:
+            string_offsets[data] = len(strings)
+            strings.extend(data + b"\0")
+        return string_offsets[data], len(data)
+
+    bucket_count = 1
+    while bucket_count < 2 * len(config_items):
+        bucket_count *= 2
+    buckets = [0] * bucket_count
+    items = bytearray()
+    for index, (key, value) in enumerate(config_items):
+        key_hash = fnv1a32(key.encode("utf-8"))
+        slot = key_hash & (bucket_count - 1)
+        while buckets[slot]:
+            slot = (slot + 1) & (bucket_count - 1)
+        buckets[slot] = index + 1
+        items += struct.pack("<IIIII", key_hash, *add_string(key), *add_string(value))
+
+    # a deduplicated file refers to its source by 1-based record index
+    indexes = {entry[0]: index + 1 for index, entry in enumerate(entries)}
+    files = bytearray()
+    for rel_path, crc, size, mode, sha256 in entries:
+        path_offset, path_length = add_string(rel_path)
+        hash_offset, _ = add_string(sha256)
+        source = indexes[aliases[rel_path]] if rel_path in aliases else 0
+        files += struct.pack(
+            "<QIIIIII", size, crc, mode, path_offset, path_length, hash_offset, source
+        )
+
+    tables = struct.pack(f"<{bucket_count}I", *buckets) + bytes(items) + bytes(files)
+    strings_offset = 32 + len(tables)
+    header = struct.pack(
+        "<8sIIIIII",
+        b"PYFZCFG1",
+        1,
+        len(config_items),
+        bucket_count,
+        len(entries),
+        strings_offset,
+        len(strings),
+    )
+    (dest_dir / BINARY_CONFIG_NAME).write_bytes(header + tables + bytes(strings))
+
+
+# Files that are already compressed or that the launcher should copy with the kernel
+# helpers (reflink, copy_file_range) straight out of the executable
+DEFAULT_STORE_PATTERNS = (
+    "*.so",
+    "*.so.*",
+    "*.dylib",
+    "*.dll",
+    "*.pyd",
+    "*.exe",
+    "*.whl",
+    "*.zip",
+    "*.gz",
+    "*.tgz",
+    "*.bz2",
+    "*.xz",
+    "*.zst",
+    "*.7z",
+    "*.jar",
+    "*.png",
+    "*.jpg",
+    "*.jpeg",
+    "*.gif",
+    "*.webp",
+    "*.woff",
+    "*.woff2",
+)
+# entries are written in the order the launcher consumes them
+EXTRACTION_PHASES = ("uv/", "python/", "cache/", ".venv/", "src/")
+ZIP_ALIGNMENT = 4096
+# stored entries smaller than this are not worth up to ZIP_ALIGNMENT bytes of padding
+ZIP_ALIGN_MIN_SIZE = 64 * 1024
+ZIP_MIN_DATE_TIME = (1980, 1, 1, 0, 0, 0)
+# entries handed to a packaging worker at once
+ZIP_BATCH_FILES = 64
+ZIP_BATCH_BYTES = 16 * 1024 * 1024
+# input bytes of the batches being compressed or waiting to be written
+ZIP_WINDOW_BYTES = 256 * 1024 * 1024
+# deflate has to save at least this share of the size to be worth inflating at runtime
+DEFLATE_MIN_SAVING = 0.1
+DEFLATE_SAMPLE_SIZE = 256 * 1024
+# extra field id used by Android's zipalign for the same kind of padding
+ALIGNMENT_EXTRA_ID = 0xD935
+# zip method 93, decompressed by the launcher's own zstd decoder
+ZIP_ZSTANDARD = 93
+ZSTD_DEFAULT_LEVEL = 9
+
+
+def matches_any(arcname: str, patterns: tuple[str, ...]) -> bool:
+    name = arcname.rsplit("/", 1)[-1]
+    return any(
+        fnmatch.fnmatchcase(arcname, p) or fnmatch.fnmatchcase(name, p)
+        for p in patterns
+    )
+
+
+def deflate_pays_off(path: Path, size: int) -> bool:
+    if size == 0:
+        return False
+    with open(path, "rb") as f:
+        sample = f.read(DEFLATE_SAMPLE_SIZE)
+    return len(zlib.compress(sample, 6)) <= len(sample) * (1 - DEFLATE_MIN_SAVING)
+
+
+def choose_compression(
+    arcname: str,
+    path: Path,
+    size: int,
+    store_patterns: tuple[str, ...],
+    deflate_patterns: tuple[str, ...],
+) -> int:
+    # the launcher mmaps it out of the executable
+    if arcname == BINARY_CONFIG_NAME:
+        return zipfile.ZIP_STORED
+    if matches_any(arcname, deflate_patterns):
+        return zipfile.ZIP_DEFLATED
+    if matches_any(arcname, store_patterns) or not deflate_pays_off(path, size):
+        return zipfile.ZIP_STORED
+    return zipfile.ZIP_DEFLATED
+
+
+def extraction_phase(arcname: str) -> int:
+    for index, prefix in enumerate(EXTRACTION_PHASES):
+        if arcname.startswith(prefix):
+            return index + 1
+    # launcher metadata and top-level files come first
+    return 0 if "/" not in arcname else len(EXTRACTION_PHASES) + 1
+
+
+def zstd_compressobj(level: int) -> Any:
+    try:
+        import zstandard
+    except ImportError:
+        try:
+            from compression import zstd  # Python 3.14+
+        except ImportError:
+            raise RuntimeError(
+                "--compression zstd needs the zstandard package (pip install pyfuze[zstd])"
+            ) from None
+        return zstd.ZstdCompressor(level)
+    return zstandard.ZstdCompressor(level=level).compressobj()
+
+
+def entry_compressor(compress_type: int, level: int | None) -> Any:
+    if compress_type == ZIP_ZSTANDARD:
+        return zstd_compressobj(ZSTD_DEFAULT_LEVEL if level is None else level)
+    # raw deflate without a zlib header, as zip stores it
+    return zlib.compressobj(
+        zlib.Z_DEFAULT_COMPRESSION if level is None else level, zlib.DEFLATED, -15
+    )
+
+
+# Decide how one entry is stored and do the CPU heavy part for it: the CRC-32 of
+# stored files, which are copied later, or the whole compressed payload.
+def prepare_entry(
+    arcname: str,
+    path: Path,
+    size: int,
+    store_patterns: tuple[str, ...],
+    deflate_patterns: tuple[str, ...],
+    compression: str,
+    compression_level: int | None,
+) -> tuple[int, int, bytes | None]:
+    compress_type = choose_compression(
+        arcname, path, size, store_patterns, deflate_patterns
+    )
+    if compression == "zstd" and compress_type == zipfile.ZIP_DEFLATED:
+        if arcname.startswith(PAYLOAD_PREFIXES):
+            compress_type = ZIP_ZSTANDARD
+    # the level only applies to the method picked with --compression
+    level = compression_level
+    if compression == "zstd" and compress_type != ZIP_ZSTANDARD:
+        level = None
+
+    crc = 0
+    compressor = None
+    if compress_type != zipfile.ZIP_STORED:
+        compressor = entry_compressor(compress_type, level)
+    chunks = []
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(1024 * 1024)
+            if not chunk:
+                break
+            crc = zlib.crc32(chunk, crc)
+            if compressor:
+                chunks.append(compressor.compress(chunk))
+    if compressor:
+        chunks.append(compressor.flush())
+        return compress_type, crc, b"".join(chunks)
+    return compress_type, crc, None
+
+
+def prepare_batch(batch: list[tuple[Any, ...]]) -> list[tuple[int, int, bytes | None]]:
+    return [prepare_entry(*args) for args in batch]
+
+
+# Run prepare_batch over batches of entries on worker processes and yield the
+# results in submission order. At most 2 batches per worker and ZIP_WINDOW_BYTES of
+# input are in flight (a single larger batch still goes alone), so the compressed
+# payloads waiting to be written take at most about max(ZIP_WINDOW_BYTES, largest
+# batch) of memory however many cores the build host has.
+def prepare_entries_in_order(
+    batches: list[list[tuple[Any, ...]]], jobs: int
+) -> Iterator[list[tuple[int, int, bytes | None]]]:
+    if jobs == 1 or len(batches) <= 1:
+        for batch in batches:
+            yield prepare_batch(batch)
+        return
+    with ProcessPoolExecutor(jobs) as pool:
+        pending: deque = deque()
+        in_flight = 0
+        for batch in batches:
+            # the third field of an entry is its file size
+            size = sum(entry[2] for entry in batch)
+            while pending and (
+                len(pending) >= jobs * 2 or in_flight + size > ZIP_WINDOW_BYTES
+            ):
+                future, done = pending.popleft()
+                in_flight -= done
+                yield future.result()
+            pending.append((pool.submit(prepare_batch, batch), size))
+            in_flight += size
+        while pending:
+            yield pending.popleft()[0].result()
+
+
+def batch_entries(
+    entries: list[tuple[Any, ...]], sizes: list[int]
+) -> list[list[tuple[Any, ...]]]:
+    batches: list[list[tuple[Any, ...]]] = []
+    batch: list[tuple[Any, ...]] = []
+    batch_bytes = 0
+    for entry, size in zip(entries, sizes):
+        batch.append(entry)
+        batch_bytes += size
+        if len(batch) >= ZIP_BATCH_FILES or batch_bytes >= ZIP_BATCH_BYTES:
+            batches.append(batch)
+            batch = []
+            batch_bytes = 0
+    if batch:
+        batches.append(batch)
+    return batches
+
+
+# Pad the local header's extra field so the entry data starts on a page boundary,
+# which lets the launcher reflink or mmap it straight out of the executable.
+def alignment_extra(zf: zipfile.ZipFile, zinfo: zipfile.ZipInfo) -> bytes:
+    filename, _ = zinfo._encodeFilenameFlags()
+    data_offset = (
+        zf.start_dir
+        + zipfile.sizeFileHeader
+        + len(filename)
+        + (20 if needs_zip64(zinfo) else 0)
+    )
+    padding = -(data_offset + 4) % ZIP_ALIGNMENT
+    return struct.pack("<HH", ALIGNMENT_EXTRA_ID, padding) + b"\0" * padding
+
+
+def needs_zip64(zinfo: zipfile.ZipInfo) -> bool:
+    return (
+        zinfo.file_size > zipfile.ZIP64_LIMIT
+        or zinfo.compress_size > zipfile.ZIP64_LIMIT
+    )
+
+
+# Append an entry whose CRC and sizes are already known, the way ZipFile.writestr
+# does, with either the precompressed payload or the stored file copied as is.
+def write_prepared_entry(
+    zf: zipfile.ZipFile, zinfo: zipfile.ZipInfo, path: Path, payload: bytes | None
+) -> None:
+    zinfo.header_offset = zf.start_dir
+    zf.fp.seek(zf.start_dir)
+    zf.fp.write(zinfo.FileHeader(needs_zip64(zinfo)))
+    if payload is None:
+        with open(path, "rb") as src:
+            shutil.copyfileobj(src, zf.fp, 1024 * 1024)
+    else:
+        zf.fp.write(payload)
+    zf.start_dir = zf.fp.tell()
+    zf.filelist.append(zinfo)
+    zf.NameToInfo[zinfo.filename] = zinfo
+    zf._didModify = True
+
+
+# Append the contents of src_dir to the executable, grouped by extraction phase and
+# sorted by path within each phase. Incompressible and native files are stored,
+# large stored files are page aligned. With compression="zstd" the compressed
+# payload entries use zstd instead of deflate.
+# Entries are compressed on `jobs` worker processes (0 means one per CPU core) and
+# written in that fixed order, so the output only depends on the input files. With
+# date_time set every entry gets that timestamp instead of the file's mtime.
+# Deduplicated files (skip) are left out, the launcher links them to their source.
+def write_bundle_zip(
+    output_path: Path,
+    src_dir: Path,
+    store_patterns: tuple[str, ...] = (),
+    deflate_patterns: tuple[str, ...] = (),
+    compression: str = "deflate",
+    compression_level: int | None = None,
+    jobs: int = 0,
+    date_time: tuple[int, int, int, int, int, int] | None = None,
+    skip: set[str] | None = None,
+) -> tuple[int, int]:
+    skip = skip or set()
+    store_patterns = DEFAULT_STORE_PATTERNS + tuple(store_patterns)
+    if compression == "zstd":
+        zstd_compressobj(ZSTD_DEFAULT_LEVEL)  # fail early if zstd is not available
+    links = venv_links(src_dir)
+    files = [
+        (item.relative_to(src_dir).as_posix(), item)
+        for item in src_dir.rglob("*")
+        if item.is_file()
+    ]
+    files = [
+        f for f in files if not is_under_link(f[0], links) and f[0] not in skip
+    ]
+    files.sort(key=lambda f: (extraction_phase(f[0]), f[0]))
+
+    zinfos = [zipfile.ZipInfo.from_file(path, arcname) for arcname, path in files]
+    entries = [
+        (
+            arcname,
+            path,
+            zinfo.file_size,
+            store_patterns,
+            deflate_patterns,
+            compression,
+            compression_level,
+        )
+        for (arcname, path), zinfo in zip(files, zinfos)
+    ]
+    batches = batch_entries(entries, [zinfo.file_size for zinfo in zinfos])
+    results = (
+        result
+        for batch in prepare_entries_in_order(batches, jobs or os.cpu_count() or 1)
+        for result in batch
+    )
+
+    stored = aligned = 0
+    with zipfile.ZipFile(output_path, "a", zipfile.ZIP_DEFLATED) as zf:
+        for (arcname, path), zinfo, (compress_type, crc, payload) in zip(
+            files, zinfos, results
+        ):
+            if date_time:
+                zinfo.date_time = date_time
+            zinfo.compress_type = compress_type
+            zinfo.CRC = crc
+            zinfo.compress_size = zinfo.file_size if payload is None else len(payload)
+            if compress_type == zipfile.ZIP_STORED:
+                stored += 1
+                if zinfo.file_size >= ZIP_ALIGN_MIN_SIZE:
+                    zinfo.extra = alignment_extra(zf, zinfo)
+                    aligned += 1
+            elif compress_type == ZIP_ZSTANDARD:
+                # version needed to extract, as the zip specification lists for zstd
+                zinfo.extract_version = 63
+            write_prepared_entry(zf, zinfo, path, payload)
+            # the padding only matters in the local header, keep the central directory small
+            zinfo.extra = b""
+    return stored, aligned
+
+
+# The launcher names a --versioned build's directory after the first word of the
+# build id and rejects longer names (MAX_VERSION_NAME in csrc/versions.c)
+BUILD_ID_NAME_MAX = 63
+
+
+# Timestamp of every entry in a reproducible build
+def reproducible_date_time() -> tuple[int, int, int, int, int, int]:
+    epoch = os.environ.get("SOURCE_DATE_EPOCH")
+    if not epoch:
+        return ZIP_MIN_DATE_TIME
+    t = datetime.fromtimestamp(int(epoch), timezone.utc)
+    # zip timestamps can't go before 1980
+    return max(ZIP_MIN_DATE_TIME, (t.year, t.month, t.day, t.hour, t.minute, t.second))
 
 
 def gen_uuid_with_time() -> str:
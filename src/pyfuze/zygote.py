@@ -0,0 +1,242 @@
+"""Fork server started by pyfuze executables packaged with --zygote.
+
+Shipped into the bundle as .pyfuze_zygote.py and run with the project's venv
+Python. It preloads the configured modules once, then forks a child per launch
+request arriving on a Unix socket in the unzip path. See csrc/zygote.c for the
+client side of the protocol:
+
+    request  "PYFZ", u32 payload length, SCM_RIGHTS stdin/stdout/stderr
+    payload  NUL separated: build id, cwd, argc, argv..., envc, env...
+    reply    i32 status (0 accepted, 1 stale build id), i32 child pid
+    result   i32 exit code (128 + signal number if the child was killed)
+"""
+
+from __future__ import annotations
+
+import argparse
+import array
+import fcntl
+import importlib
+import os
+import runpy
+import selectors
+import signal
+import socket
+import struct
+import sys
+import time
+
+SOCKET_NAME = ".pyfuze_zygote.sock"
+LOCK_NAME = ".pyfuze_zygote.lock"
+HEADER = struct.Struct("<4sI")
+MAGIC = b"PYFZ"
+MAX_PAYLOAD = 1024 * 1024
+STATUS_ACCEPTED = 0
+STATUS_STALE = 1
+
+
+def recv_exact(conn: socket.socket, size: int) -> bytes:
+    data = b""
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("client closed the connection")
+        data += chunk
+    return data
+
+
+def recv_request(conn: socket.socket) -> tuple[list[int], list[str]]:
+    fds = array.array("i")
+    data, ancdata, _, _ = conn.recvmsg(HEADER.size, socket.CMSG_SPACE(3 * fds.itemsize))
+    for level, kind, cmsg_data in ancdata:
+        if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+            fds.frombytes(cmsg_data[: len(cmsg_data) - len(cmsg_data) % fds.itemsize])
+    if len(data) < HEADER.size:
+        data += recv_exact(conn, HEADER.size - len(data))
+    magic, length = HEADER.unpack(data)
+    if magic != MAGIC or length > MAX_PAYLOAD or len(fds) != 3:
+        for fd in fds:
+            os.close(fd)
+        raise ValueError("malformed request")
+    fields = recv_exact(conn, length).decode("utf-8", "surrogateescape").split("\0")
+    return list(fds), fields
+
+
+def run_child(fds: list[int], fields: list[str], entry: str) -> None:
+    """Runs in the forked child, never returns."""
+    code = 1
+    try:
+        cwd = fields[1]
+        argc = int(fields[2])
+        argv = fields[3 : 3 + argc]
+        envc = int(fields[3 + argc])
+        env = fields[4 + argc : 4 + argc + envc]
+
+        for target, fd in enumerate(fds):
+            os.dup2(fd, target)
+            os.close(fd)
+        sys.stdin = open(0, "r", closefd=False)
+        sys.stdout = open(1, "w", buffering=1 if os.isatty(1) else -1, closefd=False)
+        sys.stderr = open(2, "w", buffering=1, closefd=False)
+
+        os.chdir(cwd)
+        os.environ.clear()
+        os.environ.update(item.split("=", 1) for item in env if "=" in item)
+        sys.argv = [entry] + argv
+        sys.path[0] = os.path.dirname(entry)
+
+        runpy.run_path(entry, run_name="__main__")
+        code = 0
+    except SystemExit as exc:
+        if exc.code is None:
+            code = 0
+        elif isinstance(exc.code, int):
+            code = exc.code
+        else:
+            print(exc.code, file=sys.stderr)
+            code = 1
+    except BaseException as exc:
+        import traceback
+
+        traceback.print_exc()
+        if isinstance(exc, KeyboardInterrupt):
+            # die from SIGINT like the interpreter does, so the exit code is 130
+            sys.stderr.flush()
+            signal.signal(signal.SIGINT, signal.SIG_DFL)
+            os.kill(os.getpid(), signal.SIGINT)
+    finally:
+        try:
+            sys.stdout.flush()
+            sys.stderr.flush()
+        finally:
+            os._exit(code & 0xFF)
+
+
+def preload(modules: list[str]) -> None:
+    for name in modules:
+        try:
+            importlib.import_module(name)
+        except Exception as exc:
+            print(f"pyfuze zygote: failed to preload {name}: {exc}", file=sys.stderr)
+
+
+def serve(args: argparse.Namespace) -> None:
+    os.chdir(args.dir)
+
+    # one zygote per unzip path, a second one started by a concurrent launch just exits
+    lock = open(LOCK_NAME, "a")
+    try:
+        fcntl.flock(lock, fcntl.LOCK_EX | fcntl.LOCK_NB)
+    except OSError:
+        return
+
+    preload([m for m in args.preload.split(",") if m])
+
+    if os.path.exists(SOCKET_NAME):
+        os.unlink(SOCKET_NAME)
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(SOCKET_NAME)
+    os.chmod(SOCKET_NAME, 0o600)
+    server.listen(64)
+    server.setblocking(False)
+
+    # SIGCHLD wakes the selector so exit codes are relayed without polling
+    wakeup_r, wakeup_w = os.pipe()
+    os.set_blocking(wakeup_w, False)
+    signal.set_wakeup_fd(wakeup_w)
+    signal.signal(signal.SIGCHLD, lambda signum, frame: None)
+
+    selector = selectors.DefaultSelector()
+    selector.register(server, selectors.EVENT_READ)
+    selector.register(wakeup_r, selectors.EVENT_READ)
+    children: dict[int, socket.socket] = {}
+    last_active = time.monotonic()
+    running = True
+
+    while running or children:
+        timeout = None if children else max(0.0, last_active + args.idle_timeout - time.monotonic())
+        for key, _ in selector.select(timeout):
+            if key.fileobj is wakeup_r:
+                os.read(wakeup_r, 4096)
+                continue
+            try:
+                conn, _ = server.accept()
+            except BlockingIOError:
+                continue
+            conn.setblocking(True)
+            last_active = time.monotonic()
+            try:
+                fds, fields = recv_request(conn)
+            except (OSError, ValueError):
+                conn.close()
+                continue
+
+            if fields[0] != args.build_id:
+                # the executable was upgraded, make room for a zygote of the new build
+                conn.sendall(struct.pack("<ii", STATUS_STALE, 0))
+                conn.close()
+                for fd in fds:
+                    os.close(fd)
+                running = False
+                selector.unregister(server)
+                continue
+
+            sys.stdout.flush()
+            sys.stderr.flush()
+            pid = os.fork()
+            if pid == 0:
+                signal.set_wakeup_fd(-1)
+                signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+                server.close()
+                lock.close()
+                os.close(wakeup_r)
+                os.close(wakeup_w)
+                for other in children.values():
+                    other.close()
+                conn.close()
+                run_child(fds, fields, args.entry)
+            for fd in fds:
+                os.close(fd)
+            conn.sendall(struct.pack("<ii", STATUS_ACCEPTED, pid))
+            children[pid] = conn
+
+        # reap finished children and report their exit codes
+        while children:
+            try:
+                pid, status = os.waitpid(-1, os.WNOHANG)
+            except ChildProcessError:
+                break
+            if pid == 0:
+                break
+            code = os.WEXITSTATUS(status) if os.WIFEXITED(status) else 128 + os.WTERMSIG(status)
+            conn = children.pop(pid, None)
+            if conn:
+                try:
+                    conn.sendall(struct.pack("<i", code))
+                except OSError:
+                    pass
+                conn.close()
+            last_active = time.monotonic()
+
+        if not children and time.monotonic() - last_active >= args.idle_timeout:
+            running = False
+        # stop accepting, the lock is released so a zygote of the new build can start
+        # while the remaining children finish
+        if not running and server.fileno() != -1:
+            os.unlink(SOCKET_NAME)
+            server.close()
+            lock.close()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--dir", required=True)
+    parser.add_argument("--build-id", required=True)
+    parser.add_argument("--entry", required=True)
+    parser.add_argument("--idle-timeout", type=float, default=300)
+    parser.add_argument("--preload", default="")
+    serve(parser.parse_args())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,170 @@
+"""Round trip of the launch manifest and binary config the packager writes.
+
+Run with `python -m unittest discover tests` from the repository root.
+"""
+
+from __future__ import annotations
+
+import os
+import struct
+import sys
+import tempfile
+import unittest
+from pathlib import Path
+from typing import Any
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent / "src"))
+
+from pyfuze.utils import (  # noqa: E402
+    BINARY_CONFIG_NAME,
+    DEDUP_MIN_SIZE,
+    MANIFEST_NAME,
+    collect_manifest_entries,
+    dedup_entries,
+    fnv1a32,
+    write_binary_config,
+    write_manifest,
+)
+
+FILE_RECORD = struct.Struct("<QIIIIII")
+
+
+def read_manifest(path: Path) -> list[tuple[int, int, int, str, str, str | None]]:
+    records = []
+    for line in path.read_text(encoding="utf-8").splitlines():
+        fields = line.split("\t")
+        source = fields[5] if len(fields) == 6 else None
+        records.append(
+            (int(fields[0], 16), int(fields[1]), int(fields[2], 8), fields[3], fields[4], source)
+        )
+    return records
+
+
+# Decode the layout documented in csrc/config.c the way the launcher does
+def read_binary_config(path: Path) -> tuple[dict[str, str], list[tuple[Any, ...]]]:
+    blob = path.read_bytes()
+    magic, version, item_count, bucket_count, file_count, strings_offset, strings_size = (
+        struct.unpack_from("<8sIIIIII", blob)
+    )
+    assert magic == b"PYFZCFG1" and version == 1
+    assert strings_offset + strings_size == len(blob)
+
+    def string(offset: int, length: int | None = None) -> str:
+        start = strings_offset + offset
+        end = blob.index(b"\0", start) if length is None else start + length
+        assert blob[end : end + 1] == b"\0"
+        return blob[start:end].decode("utf-8")
+
+    buckets = struct.unpack_from(f"<{bucket_count}I", blob, 32)
+    items_offset = 32 + 4 * bucket_count
+    items = [
+        struct.unpack_from("<IIIII", blob, items_offset + 20 * i) for i in range(item_count)
+    ]
+
+    config = {}
+    for key_hash, key_offset, key_length, value_offset, value_length in items:
+        key = string(key_offset, key_length)
+        assert key_hash == fnv1a32(key.encode("utf-8"))
+        # the launcher finds each key by linear probing from its hash
+        slot = key_hash & (bucket_count - 1)
+        while string(items[buckets[slot] - 1][1]) != key:
+            slot = (slot + 1) & (bucket_count - 1)
+        config[key] = string(value_offset, value_length)
+
+    files_offset = items_offset + 20 * item_count
+    assert files_offset + FILE_RECORD.size * file_count == strings_offset
+    records = [
+        FILE_RECORD.unpack_from(blob, files_offset + FILE_RECORD.size * i)
+        for i in range(file_count)
+    ]
+    files = []
+    for size, crc, mode, path_offset, path_length, hash_offset, source in records:
+        assert 0 <= source <= file_count
+        source_path = string(records[source - 1][3]) if source else None
+        files.append(
+            (crc, size, mode, string(hash_offset), string(path_offset, path_length), source_path)
+        )
+    return config, files
+
+
+class ManifestRoundTripTest(unittest.TestCase):
+    def setUp(self) -> None:
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dest = Path(self.tmp.name)
+        shared = os.urandom(DEDUP_MIN_SIZE * 4)
+        self.files = {
+            "python/lib/a.so": (shared, 0o755),
+            "python/lib/z.so": (shared, 0o755),
+            # same content but another mode is not an alias
+            "python/lib/b.so": (shared, 0o644),
+            ".venv/lib/site-packages/a.so": (shared, 0o755),
+            # outside the payload prefixes nothing is deduplicated
+            "src/a.so": (shared, 0o755),
+            "uv/small-a": (b"small", 0o644),
+            "uv/small-b": (b"small", 0o644),
+            # bytewise order differs from a case-insensitive or locale aware sort
+            "python/Lib/B.py": (b"B", 0o644),
+            "python/Lib/a.py": (b"a", 0o644),
+            "python/Lib/_c.py": (b"_", 0o644),
+            "python/Lib/é.py": (b"e", 0o644),
+            "python/Lib/中.py": (b"zh", 0o644),
+            "python/Lib-x/y.py": (b"y", 0o644),
+        }
+        for rel_path, (data, mode) in self.files.items():
+            path = self.dest / rel_path
+            path.parent.mkdir(parents=True, exist_ok=True)
+            path.write_bytes(data)
+            path.chmod(mode)
+
+    def tearDown(self) -> None:
+        self.tmp.cleanup()
+
+    def build(self) -> tuple[list[tuple[str, int, int, int, str]], dict[str, str]]:
+        entries = collect_manifest_entries(self.dest)
+        aliases = dedup_entries(entries)
+        write_manifest(self.dest, entries, aliases)
+        config_items = [("entry", "main.py"), ("uv_version", "0.7.3"), ("unzip", "1")]
+        write_binary_config(self.dest, config_items, entries, aliases)
+        return entries, aliases
+
+    def test_sorted_like_strcmp(self) -> None:
+        entries, _ = self.build()
+        paths = [entry[0] for entry in entries]
+        self.assertEqual(sorted(self.files), sorted(paths))
+        # the launcher checks the order with strcmp and looks paths up with bsearch
+        self.assertEqual(paths, sorted(paths, key=lambda p: p.encode("utf-8")))
+        _, files = read_binary_config(self.dest / BINARY_CONFIG_NAME)
+        self.assertEqual([f[4] for f in files], paths)
+        manifest = read_manifest(self.dest / MANIFEST_NAME)
+        self.assertEqual([r[4] for r in manifest], paths)
+
+    def test_dedup_sources(self) -> None:
+        _, aliases = self.build()
+        self.assertEqual(
+            aliases,
+            {
+                "python/lib/z.so": ".venv/lib/site-packages/a.so",
+                "python/lib/a.so": ".venv/lib/site-packages/a.so",
+            },
+        )
+
+    def test_text_and_binary_agree(self) -> None:
+        entries, aliases = self.build()
+        manifest = read_manifest(self.dest / MANIFEST_NAME)
+        config, files = read_binary_config(self.dest / BINARY_CONFIG_NAME)
+        self.assertEqual(config, {"entry": "main.py", "uv_version": "0.7.3", "unzip": "1"})
+        self.assertEqual(manifest, files)
+        by_path = {entry[0]: entry for entry in entries}
+        for crc, size, mode, sha256, rel_path, source in files:
+            data, file_mode = self.files[rel_path]
+            self.assertEqual((size, mode), (len(data), file_mode))
+            self.assertEqual((crc, sha256), by_path[rel_path][1:2] + by_path[rel_path][4:])
+            self.assertEqual(source, aliases.get(rel_path))
+            if source is not None:
+                # a source is itself stored, never another alias
+                self.assertNotIn(source, aliases)
+                self.assertEqual(self.files[source], self.files[rel_path])
+
+
+if __name__ == "__main__":
+    unittest.main()